@@ -0,0 +1,88 @@
+#include <fstream>
+#include <algorithm>
+
+#include "catalog.h"
+#include "exception.h"
+
+CatalogWriter::CatalogWriter(std::vector<std::string> const & names) : columns(names.size()), rowCount(0) {
+	for (size_t j = 0; j < names.size(); j++) {
+		columns[j].name = names[j];
+	}
+}
+
+void CatalogWriter::addRow(const std::string *cols) {
+	for (size_t j = 0; j < columns.size(); j++) {
+		Column &col = columns[j];
+		col.text += cols[j];
+		col.ends.push_back(col.text.size());
+		col.width = std::max(col.width, cols[j].size());
+	}
+	++rowCount;
+}
+
+void CatalogWriter::write(std::string const & datFilename, std::string const & specsFilename) const {
+	{
+		std::ofstream specsFile(specsFilename);
+		if (!specsFile) throw Exception() << "failed to open file " << specsFilename;
+		for (auto const & col : columns) {
+			specsFile << col.name << "=" << col.width << std::endl;
+		}
+	}
+
+	std::ofstream datFile(datFilename, std::ios::binary);	//binary so it is byte-accurate, so i can fseek through it
+	if (!datFile) throw Exception() << "failed to open file " << datFilename;
+	size_t rowSize = 0;
+	for (auto const & col : columns) {
+		rowSize += col.width;
+	}
+	std::string row;
+	for (size_t i = 0; i < rowCount; i++) {
+		row.assign(rowSize, '\0');
+		size_t offset = 0;
+		for (auto const & col : columns) {
+			uint64_t begin = i ? col.ends[i-1] : 0;
+			std::copy(col.text.begin() + begin, col.text.begin() + col.ends[i], row.begin() + offset);
+			offset += col.width;
+		}
+		datFile.write(row.data(), row.size());
+	}
+	if (!datFile) throw Exception() << "failed to write " << datFilename;
+}
+
+CatalogReader::CatalogReader(std::string const & datFilename, std::string const & specsFilename) : rowSize(0), file(datFilename) {
+	std::ifstream specsFile(specsFilename);
+	if (!specsFile) throw Exception() << "failed to open file " << specsFilename;
+	std::string line;
+	while (std::getline(specsFile, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty()) continue;
+		if (line[0] == '{') throw Exception() << specsFilename << " is a lua table, from an older convert-simbad.lua.  delete it and run convert-simbad.lua again";
+		size_t eq = line.find('=');
+		if (eq == std::string::npos) throw Exception() << "got a bad line in " << specsFilename << ": " << line;
+		Column col;
+		col.name = line.substr(0, eq);
+		col.offset = rowSize;
+		try {
+			col.width = std::stoul(line.substr(eq + 1));
+		} catch (std::exception &) {
+			throw Exception() << "got a bad width in " << specsFilename << ": " << line;
+		}
+		rowSize += col.width;
+		columns.push_back(col);
+	}
+	if (rowSize && file.size() % rowSize) throw Exception() << datFilename << " isn't a whole number of " << rowSize << " byte rows";
+}
+
+std::string_view CatalogReader::field(size_t row, size_t col) const {
+	const char *p = (const char*)file.data() + row * rowSize + columns[col].offset;
+	size_t width = columns[col].width;
+	const char *end = std::find(p, p + width, '\0');
+	return std::string_view(p, end - p);
+}
+
+int CatalogReader::findColumn(std::string const & name) const {
+	for (size_t j = 0; j < columns.size(); j++) {
+		if (columns[j].name == name) return (int)j;
+	}
+	return -1;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util.h"
+
+/*
+text catalogs that go with a point file, row i describing point i.
+they're written to datasets/<set>/catalog.*, and served as <set>-catalog.* for getpoint.lua
+
+catalog.specs is a line of name=width per column, in order.
+catalog.dat is the rows back to back, each column null-padded to its width, so row i is at i * the sum of the widths.
+*/
+
+//spools the columns as rows come in, then writes both files once every width is known.
+//that way the rows only have to be read once.
+struct CatalogWriter {
+	CatalogWriter(std::vector<std::string> const & names);
+
+	//one string per column
+	void addRow(const std::string *cols);
+
+	size_t numRows() const { return rowCount; }
+
+	void write(std::string const & datFilename, std::string const & specsFilename) const;
+
+protected:
+	struct Column {
+		std::string name;
+		std::string text;	//every row's text, back to back
+		std::vector<uint64_t> ends;	//per row, its end in text
+		size_t width = 0;	//longest row
+	};
+	std::vector<Column> columns;
+	size_t rowCount;
+};
+
+//catalog.dat, mapped, with the layout from its specs
+struct CatalogReader {
+	struct Column {
+		std::string name;
+		size_t offset, width;	//within a row
+	};
+	std::vector<Column> columns;
+	size_t rowSize;
+	MappedFile file;
+
+	CatalogReader(std::string const & datFilename, std::string const & specsFilename);
+
+	size_t numRows() const { return rowSize ? file.size() / rowSize : 0; }
+
+	//the text without its null padding
+	std::string_view field(size_t row, size_t col) const;
+
+	//-1 if there's no such column
+	int findColumn(std::string const & name) const;
+};
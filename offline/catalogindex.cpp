@@ -0,0 +1,137 @@
+#include <fstream>
+#include <algorithm>
+#include <cstring>	//std::memcmp
+#include <cctype>
+
+#include "catalogindex.h"
+#include "catalog.h"
+#include "exception.h"
+
+const char CatalogIndexFileHeader::signature[4] = {'C', 'I', 'D', 'X'};
+
+//2mrs names are stored as NGC_1208, VV_596, so '_' separates words like a space does
+static bool isSeparator(char c) {
+	return isspace((unsigned char)c) || c == '_';
+}
+
+std::string normalizeIdentifier(std::string_view s) {
+	std::string result;
+	result.reserve(s.size());
+	bool space = false;
+	for (char c : s) {
+		if (isSeparator(c)) {
+			space = true;
+			continue;
+		}
+		if (space && !result.empty()) result += ' ';
+		space = false;
+		result += (char)tolower((unsigned char)c);
+	}
+	return result;
+}
+
+//fnv-1a
+uint64_t hashIdentifier(std::string_view s) {
+	uint64_t h = 14695981039346656037ull;
+	for (char c : s) {
+		h ^= (unsigned char)c;
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+void writeCatalogIndex(std::string const & filename, CatalogReader const & catalog, std::vector<int> const & columns) {
+	size_t numRows = catalog.numRows();
+	if (numRows > UINT32_MAX) throw Exception() << "too many rows to index: " << numRows;
+
+	//(key, row) for every field, sorted so each key's rows are together and ascending
+	std::vector<std::pair<std::string, uint32_t>> entries;
+	for (size_t row = 0; row < numRows; row++) {
+		for (int col : columns) {
+			std::string key = normalizeIdentifier(catalog.field(row, col));
+			if (!key.empty()) entries.push_back(std::make_pair(std::move(key), (uint32_t)row));
+		}
+	}
+	std::sort(entries.begin(), entries.end());
+	//a row with the same name in two columns only needs it once
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+	std::vector<CatalogIndexKey> keys;
+	std::vector<uint32_t> refs;
+	std::string text;
+	for (size_t i = 0; i < entries.size();) {
+		std::string const & key = entries[i].first;
+		CatalogIndexKey k = {};
+		k.hash = hashIdentifier(key);
+		k.textOffset = text.size();
+		k.textLength = (uint32_t)key.size();
+		k.refBegin = (uint32_t)refs.size();
+		for (; i < entries.size() && entries[i].first == key; i++) {
+			refs.push_back(entries[i].second);
+		}
+		k.refCount = (uint32_t)refs.size() - k.refBegin;
+		text += key;
+		keys.push_back(k);
+	}
+
+	//at most half full, so probes stay short
+	uint32_t numSlots = 16;
+	while (numSlots < 2 * keys.size()) numSlots <<= 1;
+	std::vector<uint32_t> slots(numSlots);
+	for (uint32_t i = 0; i < (uint32_t)keys.size(); i++) {
+		uint32_t s = (uint32_t)keys[i].hash & (numSlots - 1);
+		while (slots[s]) s = (s + 1) & (numSlots - 1);
+		slots[s] = i + 1;
+	}
+
+	std::ofstream f(filename, std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename << " for writing";
+	CatalogIndexFileHeader header = {};
+	std::memcpy(header.magic, CatalogIndexFileHeader::signature, sizeof(header.magic));
+	header.version = CatalogIndexFileHeader::currentVersion;
+	header.catalogSize = catalog.file.size();
+	header.numRows = (uint32_t)numRows;
+	header.numSlots = numSlots;
+	header.numKeys = (uint32_t)keys.size();
+	header.numRefs = (uint32_t)refs.size();
+	header.textSize = text.size();
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(slots.data()), sizeof(uint32_t) * slots.size());
+	f.write(reinterpret_cast<const char*>(keys.data()), sizeof(CatalogIndexKey) * keys.size());
+	f.write(reinterpret_cast<const char*>(refs.data()), sizeof(uint32_t) * refs.size());
+	f.write(text.data(), text.size());
+	if (!f) throw Exception() << "failed to write " << filename;
+}
+
+CatalogIndex::CatalogIndex(std::string const & filename) : file(filename) {
+	const char *data = (const char*)file.data();
+	if (file.size() < sizeof(CatalogIndexFileHeader)) throw Exception() << filename << " is too small to be a catalog index";
+	header = (const CatalogIndexFileHeader*)data;
+	if (std::memcmp(header->magic, CatalogIndexFileHeader::signature, sizeof(header->magic))) throw Exception() << filename << " is not a catalog index";
+	if (header->version != CatalogIndexFileHeader::currentVersion) throw Exception() << filename << " has unknown version " << header->version;
+	size_t expected = sizeof(CatalogIndexFileHeader)
+		+ sizeof(uint32_t) * (size_t)header->numSlots
+		+ sizeof(CatalogIndexKey) * (size_t)header->numKeys
+		+ sizeof(uint32_t) * (size_t)header->numRefs
+		+ header->textSize;
+	if (file.size() != expected) throw Exception() << filename << " is " << file.size() << " bytes but should be " << expected;
+	if (!header->numSlots || (header->numSlots & (header->numSlots - 1))) throw Exception() << filename << " has " << header->numSlots << " slots, which isn't a power of two";
+	slots = (const uint32_t*)(data + sizeof(CatalogIndexFileHeader));
+	keys = (const CatalogIndexKey*)(slots + header->numSlots);
+	refs = (const uint32_t*)(keys + header->numKeys);
+	text = (const char*)(refs + header->numRefs);
+}
+
+CatalogIndex::Rows CatalogIndex::find(std::string_view ident) const {
+	std::string key = normalizeIdentifier(ident);
+	uint64_t hash = hashIdentifier(key);
+	uint32_t mask = header->numSlots - 1;
+	for (uint32_t s = (uint32_t)hash & mask;; s = (s + 1) & mask) {
+		uint32_t slot = slots[s];
+		if (!slot) return Rows{refs, refs};
+		const CatalogIndexKey &k = keys[slot - 1];
+		if (k.hash == hash && keyText(slot - 1) == key) {
+			return Rows{refs + k.refBegin, refs + k.refBegin + k.refCount};
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util.h"
+
+struct CatalogReader;
+
+/*
+identifier index over a catalog.dat.  index-catalog writes datasets/<set>/catalog.idx
+keys are normalized identifiers from chosen columns (2MASS ID, galaxy name, simbad id...), values are the rows they're in.
+row i is point i, so rows are point indexes too.
+the file is meant to be memory mapped, see CatalogIndex.  a lookup is a hash and a probe or two, however big the catalog.
+
+layout, little endian:
+	CatalogIndexFileHeader
+	uint32_t [numSlots] -- open addressing hash table, linear probing.  key index + 1, 0 for empty.  numSlots is a power of two
+	CatalogIndexKey [numKeys] -- sorted by text
+	uint32_t [numRefs] -- rows, ascending within each key
+	char [textSize] -- the normalized keys, back to back
+*/
+struct CatalogIndexFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t catalogSize;	//catalog.dat's size when this was built, to spot a stale index
+	uint32_t numRows;
+	uint32_t numSlots;
+	uint32_t numKeys;
+	uint32_t numRefs;
+	uint64_t textSize;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 2;	//2 folds '_' into spaces
+};
+
+struct CatalogIndexKey {
+	uint64_t hash;
+	uint64_t textOffset;
+	uint32_t textLength;
+	uint32_t refBegin, refCount;
+	uint32_t pad;
+};
+
+//lowercase, with runs of whitespace and '_' made one space and trimmed off the ends.  like findpoint.lua does to both sides, plus the '_'.
+//'-', '+' and '.' are left alone, they're signs and decimal points in the coordinate names.
+std::string normalizeIdentifier(std::string_view s);
+
+uint64_t hashIdentifier(std::string_view s);
+
+//indexes every non-empty field of these columns
+void writeCatalogIndex(std::string const & filename, CatalogReader const & catalog, std::vector<int> const & columns);
+
+struct CatalogIndex {
+	MappedFile file;
+	const CatalogIndexFileHeader *header;
+	const uint32_t *slots;
+	const CatalogIndexKey *keys;
+	const uint32_t *refs;
+	const char *text;
+
+	CatalogIndex(std::string const & filename);
+
+	struct Rows {
+		const uint32_t *begin, *end;
+		size_t size() const { return end - begin; }
+	};
+
+	//rows with exactly this identifier, normalized first.  empty if there are none.
+	Rows find(std::string_view ident) const;
+
+	std::string_view keyText(uint32_t key) const { return std::string_view(text + keys[key].textOffset, keys[key].textLength); }
+};
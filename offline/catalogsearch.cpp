@@ -0,0 +1,214 @@
+#include <fstream>
+#include <algorithm>
+#include <cstring>	//std::memcmp
+#include <cctype>
+
+#include "catalogsearch.h"
+#include "catalogindex.h"	//normalizeIdentifier
+#include "catalog.h"
+#include "exception.h"
+
+const char CatalogSearchFileHeader::signature[4] = {'C', 'S', 'R', 'H'};
+
+static uint32_t makeGram(unsigned char a, unsigned char b, unsigned char c) {
+	return ((uint32_t)a << 16) | ((uint32_t)b << 8) | (uint32_t)c;
+}
+
+void writeCatalogSearch(std::string const & filename, CatalogReader const & catalog, std::vector<int> const & columns) {
+	size_t numRows = catalog.numRows();
+	size_t numColumns = columns.size();
+	if (numRows * numColumns >= UINT32_MAX) throw Exception() << "too many fields to index: " << numRows << " rows of " << numColumns;
+
+	std::string text;
+	std::vector<uint32_t> offsets;
+	offsets.reserve(numRows * numColumns + 1);
+	offsets.push_back(0);
+	for (size_t row = 0; row < numRows; row++) {
+		for (int col : columns) {
+			text += normalizeIdentifier(catalog.field(row, col));
+			if (text.size() >= UINT32_MAX) throw Exception() << "too much text to index";
+			offsets.push_back((uint32_t)text.size());
+		}
+	}
+
+	//each row's distinct trigrams, with the fields null-padded at the end
+	std::vector<uint32_t> rowGrams;
+	auto gramsOfRow = [&](size_t row) {
+		rowGrams.clear();
+		for (size_t j = 0; j < numColumns; j++) {
+			const unsigned char *f = (const unsigned char*)text.data() + offsets[row * numColumns + j];
+			size_t len = offsets[row * numColumns + j + 1] - offsets[row * numColumns + j];
+			for (size_t i = 0; i < len; i++) {
+				rowGrams.push_back(makeGram(f[i], i + 1 < len ? f[i+1] : 0, i + 2 < len ? f[i+2] : 0));
+			}
+		}
+		std::sort(rowGrams.begin(), rowGrams.end());
+		rowGrams.erase(std::unique(rowGrams.begin(), rowGrams.end()), rowGrams.end());
+	};
+
+	//counting sort by gram.  filling in row order keeps each gram's rows ascending.
+	std::vector<uint32_t> counts(1 << 24);
+	size_t numPostings = 0;
+	for (size_t row = 0; row < numRows; row++) {
+		gramsOfRow(row);
+		for (uint32_t g : rowGrams) {
+			counts[g]++;
+		}
+		numPostings += rowGrams.size();
+	}
+	if (numPostings >= UINT32_MAX) throw Exception() << "too many trigrams to index: " << numPostings;
+
+	std::vector<CatalogSearchGram> grams;
+	uint32_t begin = 0;
+	for (uint32_t g = 0; g < counts.size(); g++) {
+		if (!counts[g]) continue;
+		grams.push_back(CatalogSearchGram{g, begin});
+		begin += counts[g];
+		counts[g] = grams.back().postingBegin;	//now where the next row goes
+	}
+	grams.push_back(CatalogSearchGram{UINT32_MAX, begin});
+
+	std::vector<uint32_t> postings(numPostings);
+	for (size_t row = 0; row < numRows; row++) {
+		gramsOfRow(row);
+		for (uint32_t g : rowGrams) {
+			postings[counts[g]++] = (uint32_t)row;
+		}
+	}
+
+	std::ofstream f(filename, std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename << " for writing";
+	CatalogSearchFileHeader header = {};
+	std::memcpy(header.magic, CatalogSearchFileHeader::signature, sizeof(header.magic));
+	header.version = CatalogSearchFileHeader::currentVersion;
+	header.catalogSize = catalog.file.size();
+	header.numRows = (uint32_t)numRows;
+	header.numColumns = (uint32_t)numColumns;
+	header.numGrams = (uint32_t)grams.size() - 1;
+	header.numPostings = (uint32_t)numPostings;
+	header.textSize = (uint32_t)text.size();
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(grams.data()), sizeof(CatalogSearchGram) * grams.size());
+	f.write(reinterpret_cast<const char*>(postings.data()), sizeof(uint32_t) * postings.size());
+	f.write(reinterpret_cast<const char*>(offsets.data()), sizeof(uint32_t) * offsets.size());
+	f.write(text.data(), text.size());
+	if (!f) throw Exception() << "failed to write " << filename;
+}
+
+CatalogSearch::CatalogSearch(std::string const & filename) : file(filename) {
+	const char *data = (const char*)file.data();
+	if (file.size() < sizeof(CatalogSearchFileHeader)) throw Exception() << filename << " is too small to be a catalog search index";
+	header = (const CatalogSearchFileHeader*)data;
+	if (std::memcmp(header->magic, CatalogSearchFileHeader::signature, sizeof(header->magic))) throw Exception() << filename << " is not a catalog search index";
+	if (header->version != CatalogSearchFileHeader::currentVersion) throw Exception() << filename << " has unknown version " << header->version;
+	size_t numFields = (size_t)header->numRows * header->numColumns;
+	size_t expected = sizeof(CatalogSearchFileHeader)
+		+ sizeof(CatalogSearchGram) * ((size_t)header->numGrams + 1)
+		+ sizeof(uint32_t) * (size_t)header->numPostings
+		+ sizeof(uint32_t) * (numFields + 1)
+		+ header->textSize;
+	if (file.size() != expected) throw Exception() << filename << " is " << file.size() << " bytes but should be " << expected;
+	grams = (const CatalogSearchGram*)(data + sizeof(CatalogSearchFileHeader));
+	postings = (const uint32_t*)(grams + header->numGrams + 1);
+	offsets = postings + header->numPostings;
+	text = (const char*)(offsets + numFields + 1);
+	if (grams[header->numGrams].postingBegin != header->numPostings) throw Exception() << filename << " grams don't add up to its posting count";
+	if (offsets[numFields] != header->textSize) throw Exception() << filename << " offsets don't add up to its text size";
+}
+
+const CatalogSearchGram *CatalogSearch::findGram(uint32_t gram) const {
+	const CatalogSearchGram *end = grams + header->numGrams;
+	const CatalogSearchGram *g = std::lower_bound(grams, end, gram, [](const CatalogSearchGram &a, uint32_t b) { return a.gram < b; });
+	return g != end && g->gram == gram ? g : nullptr;
+}
+
+std::vector<uint32_t> CatalogSearch::rowsInGramRange(uint32_t begin, uint32_t end) const {
+	const CatalogSearchGram *last = grams + header->numGrams;
+	auto less = [](const CatalogSearchGram &a, uint32_t b) { return a.gram < b; };
+	const CatalogSearchGram *g0 = std::lower_bound(grams, last, begin, less);
+	const CatalogSearchGram *g1 = std::lower_bound(g0, last, end, less);
+	std::vector<uint32_t> rows(postings + g0->postingBegin, postings + g1->postingBegin);
+	std::sort(rows.begin(), rows.end());
+	rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+	return rows;
+}
+
+std::vector<CatalogSearch::Match> CatalogSearch::find(std::string_view query, size_t limit) const {
+	std::vector<Match> matches;
+	std::string q = normalizeIdentifier(query);
+	if (q.empty() || !limit) return matches;
+	const unsigned char *u = (const unsigned char*)q.data();
+
+	std::vector<uint32_t> candidates;
+	if (q.size() < 3) {
+		//every gram that starts with the query
+		uint32_t begin = q.size() == 1 ? makeGram(u[0], 0, 0) : makeGram(u[0], u[1], 0);
+		uint32_t end = begin + (q.size() == 1 ? 1 << 16 : 1 << 8);
+		candidates = rowsInGramRange(begin, end);
+	} else {
+		//intersect the query's gram lists, shortest first
+		std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+		for (size_t i = 0; i + 2 < q.size(); i++) {
+			const CatalogSearchGram *g = findGram(makeGram(u[i], u[i+1], u[i+2]));
+			if (!g) return matches;
+			lists.push_back(std::make_pair(postings + g->postingBegin, postings + g[1].postingBegin));
+		}
+		std::sort(lists.begin(), lists.end(), [](auto const & a, auto const & b) { return a.second - a.first < b.second - b.first; });
+		candidates.assign(lists[0].first, lists[0].second);
+		for (size_t l = 1; l < lists.size() && !candidates.empty(); l++) {
+			const uint32_t *p = lists[l].first;
+			size_t n = 0;
+			for (uint32_t row : candidates) {
+				p = std::lower_bound(p, lists[l].second, row);
+				if (p == lists[l].second) break;
+				if (*p == row) candidates[n++] = row;
+			}
+			candidates.resize(n);
+		}
+	}
+
+	//trigrams can all be there without the query being there, so check each, and rank by its best field
+	std::vector<std::pair<Match, size_t>> ranked;	//and the field's length
+	for (uint32_t row : candidates) {
+		Match best = {row, 0, RANK_SUBSTRING};
+		size_t bestLength = 0;
+		bool found = false;
+		for (uint32_t j = 0; j < header->numColumns; j++) {
+			std::string_view f = field(row, j);
+			Rank rank = RANK_SUBSTRING;
+			size_t pos = f.find(q);
+			if (pos == std::string_view::npos) continue;
+			if (f.size() == q.size()) {
+				rank = RANK_EXACT;
+			} else if (pos == 0) {
+				rank = RANK_PREFIX;
+			} else {
+				for (; pos != std::string_view::npos; pos = f.find(q, pos + 1)) {
+					if (!isalnum((unsigned char)f[pos-1])) {
+						rank = RANK_WORD;
+						break;
+					}
+				}
+			}
+			if (!found || rank < best.rank || (rank == best.rank && f.size() < bestLength)) {
+				best.column = j;
+				best.rank = rank;
+				bestLength = f.size();
+				found = true;
+			}
+		}
+		if (found) ranked.push_back(std::make_pair(best, bestLength));
+	}
+
+	auto better = [](std::pair<Match, size_t> const & a, std::pair<Match, size_t> const & b) {
+		if (a.first.rank != b.first.rank) return a.first.rank < b.first.rank;
+		if (a.second != b.second) return a.second < b.second;
+		return a.first.row < b.first.row;
+	};
+	size_t n = std::min(limit, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(), better);
+	for (size_t i = 0; i < n; i++) {
+		matches.push_back(ranked[i].first);
+	}
+	return matches;
+}
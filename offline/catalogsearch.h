@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "util.h"
+
+struct CatalogReader;
+
+/*
+substring search over a catalog.dat's names.  index-catalog writes datasets/<set>/catalog.search next to catalog.idx
+fields are normalized like identifiers, see normalizeIdentifier, and each is indexed by its trigrams.
+a query's trigrams narrow it down to the rows that have all of them, then those are checked and ranked,
+so a search costs about the size of its rarest trigram's list instead of the whole catalog.
+fields are padded with two nulls, so one and two letter queries are a range of trigrams too.
+
+layout, little endian:
+	CatalogSearchFileHeader
+	CatalogSearchGram [numGrams + 1] -- sorted by gram.  the last is a sentinel, so gram i's rows end where gram i+1's begin
+	uint32_t [numPostings] -- rows, ascending within each gram
+	uint32_t [numRows * numColumns + 1] -- offsets into text.  field j of row i is text[offsets[i * numColumns + j], offsets[i * numColumns + j + 1])
+	char [textSize] -- the normalized fields, back to back
+*/
+struct CatalogSearchFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t catalogSize;	//catalog.dat's size when this was built, to spot a stale index
+	uint32_t numRows;
+	uint32_t numColumns;	//how many were indexed
+	uint32_t numGrams;
+	uint32_t numPostings;
+	uint32_t textSize;
+	uint32_t pad;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 2;	//2 folds '_' into spaces
+};
+
+struct CatalogSearchGram {
+	uint32_t gram;	//three bytes, first in the high bits
+	uint32_t postingBegin;
+};
+
+//indexes the fields of these columns
+void writeCatalogSearch(std::string const & filename, CatalogReader const & catalog, std::vector<int> const & columns);
+
+struct CatalogSearch {
+	MappedFile file;
+	const CatalogSearchFileHeader *header;
+	const CatalogSearchGram *grams;
+	const uint32_t *postings;
+	const uint32_t *offsets;
+	const char *text;
+
+	CatalogSearch(std::string const & filename);
+
+	//lower ranks are better
+	enum Rank {
+		RANK_EXACT,	//the whole field
+		RANK_PREFIX,	//the start of the field
+		RANK_WORD,	//the start of a word in it
+		RANK_SUBSTRING,	//anywhere
+	};
+
+	struct Match {
+		uint32_t row;
+		uint32_t column;	//# in the order they were indexed
+		Rank rank;
+	};
+
+	//rows with the normalized query in one of their fields, best first: by rank, then shorter field, then row.  at most limit of them.
+	std::vector<Match> find(std::string_view query, size_t limit) const;
+
+	std::string_view field(uint32_t row, uint32_t column) const {
+		size_t i = (size_t)row * header->numColumns + column;
+		return std::string_view(text + offsets[i], offsets[i+1] - offsets[i]);
+	}
+
+protected:
+	//rows in [begin, end) of the sorted grams, each once
+	std::vector<uint32_t> rowsInGramRange(uint32_t begin, uint32_t end) const;
+	const CatalogSearchGram *findGram(uint32_t gram) const;
+};
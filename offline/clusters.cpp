@@ -0,0 +1,104 @@
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstring>	//std::memcmp
+
+#include "clusters.h"
+#include "exception.h"
+
+const char ClusterFileHeader::signature[4] = {'C', 'S', 'R', 'C'};
+
+void writeClusterCatalog(std::string const & filename, const vec3f *vtxs, const int *labels, int numVtxs, int numClusters) {
+	//counting sort by label.  filling in vertex order keeps each cluster's members ascending.
+	std::vector<uint32_t> offsets(numClusters + 1);
+	for (int i = 0; i < numVtxs; i++) {
+		if (labels[i] < 0 || labels[i] >= numClusters) throw Exception() << "vertex " << i << " has cluster " << labels[i] << " out of range";
+		offsets[labels[i] + 1]++;
+	}
+	for (int i = 0; i < numClusters; i++) {
+		offsets[i+1] += offsets[i];
+	}
+	std::vector<uint32_t> members(numVtxs);
+	{
+		std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < numVtxs; i++) {
+			members[next[labels[i]]++] = i;
+		}
+	}
+
+	std::vector<ClusterSummary> summaries(numClusters);
+	for (int c = 0; c < numClusters; c++) {
+		summarizeCluster(summaries[c], vtxs, members.data() + offsets[c], members.data() + offsets[c+1]);
+	}
+
+	std::ofstream f(filename, std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename << " for writing";
+	ClusterFileHeader header = {};
+	std::memcpy(header.magic, ClusterFileHeader::signature, sizeof(header.magic));
+	header.version = ClusterFileHeader::currentVersion;
+	header.numClusters = numClusters;
+	header.numMembers = numVtxs;
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(summaries.data()), sizeof(ClusterSummary) * summaries.size());
+	f.write(reinterpret_cast<const char*>(offsets.data()), sizeof(uint32_t) * offsets.size());
+	f.write(reinterpret_cast<const char*>(members.data()), sizeof(uint32_t) * members.size());
+	if (!f) throw Exception() << "failed to write " << filename;
+}
+
+void summarizeCluster(ClusterSummary &s, const vec3f *vtxs, const uint32_t *begin, const uint32_t *end) {
+	s.size = (uint32_t)(end - begin);
+
+	vec3d center;
+	vec3f min = vtxs[*begin], max = vtxs[*begin];
+	for (const uint32_t *m = begin; m < end; m++) {
+		const vec3f &v = vtxs[*m];
+		center += (vec3d)v;
+		for (int k = 0; k < 3; k++) {
+			min(k) = std::min(min(k), v(k));
+			max(k) = std::max(max(k), v(k));
+		}
+	}
+	center *= 1. / (double)s.size;
+
+	//a cluster centered on the observer, like convert-2mrs --add-milky-way's, has no line of sight, so it's all transverse
+	vec3d unitC;
+	if (center.lenSq() > 0) unitC = vec3d(center).normalize();
+	double radialSq = 0, transverseSq = 0, radialMax = 0, transverseMax = 0;
+	for (const uint32_t *m = begin; m < end; m++) {
+		vec3d d = (vec3d)vtxs[*m] - center;
+		double radial = vec3d::dot(d, unitC);
+		double transverse = (d - radial * unitC).len();
+		radialSq += radial * radial;
+		transverseSq += transverse * transverse;
+		radialMax = std::max(radialMax, fabs(radial));
+		transverseMax = std::max(transverseMax, transverse);
+	}
+
+	for (int k = 0; k < 3; k++) {
+		s.centroid[k] = (float)center(k);
+		s.min[k] = min(k);
+		s.max[k] = max(k);
+	}
+	s.radialDispersion = (float)sqrt(radialSq / (double)s.size);
+	s.transverseDispersion = (float)sqrt(transverseSq / (double)s.size);
+	s.radialMax = (float)radialMax;
+	s.transverseMax = (float)transverseMax;
+}
+
+ClusterCatalog::ClusterCatalog(std::string const & filename, bool writable)
+: file(filename, writable ? MappedFile::MAP_WRITE : MappedFile::MAP_READ_ONLY) {
+	char *data = (char*)file.data();
+	if (file.size() < sizeof(ClusterFileHeader)) throw Exception() << filename << " is too small to be a cluster catalog";
+	header = (const ClusterFileHeader*)data;
+	if (std::memcmp(header->magic, ClusterFileHeader::signature, sizeof(header->magic))) throw Exception() << filename << " is not a cluster catalog";
+	if (header->version != ClusterFileHeader::currentVersion) throw Exception() << filename << " has unknown version " << header->version;
+	size_t expected = sizeof(ClusterFileHeader)
+		+ sizeof(ClusterSummary) * (size_t)header->numClusters
+		+ sizeof(uint32_t) * ((size_t)header->numClusters + 1)
+		+ sizeof(uint32_t) * (size_t)header->numMembers;
+	if (file.size() != expected) throw Exception() << filename << " is " << file.size() << " bytes but should be " << expected;
+	summaries = (ClusterSummary*)(data + sizeof(ClusterFileHeader));
+	offsets = (const uint32_t*)(summaries + header->numClusters);
+	members = offsets + header->numClusters + 1;
+	if (offsets[header->numClusters] != header->numMembers) throw Exception() << filename << " offsets don't add up to its member count";
+}
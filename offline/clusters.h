@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "vec.h"
+#include "util.h"
+
+/*
+cluster catalog.  mark-clusters writes datasets/<set>/points/<base>.csr next to the .clusters labels.
+members are stored compressed sparse row: each cluster's vertex indexes are one contiguous run,
+so a cluster can be walked without regrouping the per-vertex labels.
+the file is meant to be memory mapped, see ClusterCatalog.
+
+layout, little endian:
+	ClusterFileHeader
+	ClusterSummary [numClusters]
+	uint32_t [numClusters+1] -- offsets into members.  cluster i is members[offsets[i], offsets[i+1])
+	uint32_t [numMembers] -- vertex indexes, ascending within each cluster
+
+every vertex is in exactly one cluster, singletons included, so numMembers is the vertex count.
+clusters are numbered as in .clusters: in order of their first vertex.
+*/
+struct ClusterFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numClusters;
+	uint32_t numMembers;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 1;
+};
+
+/*
+radial is along the line of sight to the centroid, transverse is the rest.  a centroid at the origin has no line of sight, so radial is 0.
+dispersions are rms distances from the centroid, maxes are the farthest member.
+*/
+struct ClusterSummary {
+	uint32_t size;
+	float centroid[3];
+	float min[3], max[3];
+	float radialDispersion, transverseDispersion;
+	float radialMax, transverseMax;
+};
+
+//labels are 0..numClusters-1
+void writeClusterCatalog(std::string const & filename, const vec3f *vtxs, const int *labels, int numVtxs, int numClusters);
+
+//fills in the summary of the cluster with members [begin,end)
+void summarizeCluster(ClusterSummary &s, const vec3f *vtxs, const uint32_t *begin, const uint32_t *end);
+
+struct ClusterCatalog {
+	MappedFile file;
+	const ClusterFileHeader *header;
+	ClusterSummary *summaries;	//only writable if opened writable
+	const uint32_t *offsets;
+	const uint32_t *members;
+
+	//writable maps the file shared, so updated summaries go straight back to it
+	ClusterCatalog(std::string const & filename, bool writable = false);
+
+	int numClusters() const { return header->numClusters; }
+	int numMembers() const { return header->numMembers; }
+	const ClusterSummary &summary(int i) const { return summaries[i]; }
+	ClusterSummary &summary(int i) { return summaries[i]; }
+	const uint32_t *begin(int i) const { return members + offsets[i]; }
+	const uint32_t *end(int i) const { return members + offsets[i+1]; }
+};
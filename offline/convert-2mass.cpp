@@ -1,22 +1,19 @@
-/*
-TODO
-perf test, strtok vs std::getline, buffer all vs explicit unrolled (current) method
-*/
-#include <cstdlib>		// system()
-#include <cstring>		// std::strtok
+#include <cstring>
 #include <filesystem>
 #include <cmath>
 #include <iostream>
 #include "batch.h"
 #include "util.h"
+#include "stat.h"
+#include "ingest.h"
 
 bool FORCE = false;
-bool PRESERVE = false;
 bool VERBOSE = false;
 bool INTERACTIVE = false;
 bool OMIT_WRITE = false;
 bool USE_DIST_OPT = false;
 bool R_VS_DIST_OPT = false;
+bool WRITE_STATS = false;
 
 /*
 http://www.ipac.caltech.edu/2mass/releases/allsky/doc/sec4_5a.html#stardiscrim
@@ -107,6 +104,26 @@ observed-flux = 0-magnitude-flux * 10^((observed-magnitude - 0-magnitude) / -2.5
 
 
 */
+//the psc columns we use, out of 60.  http://www.ipac.caltech.edu/2mass/releases/allsky/doc/sec2_2a.html
+enum {
+	PSC_RA = 0,
+	PSC_DEC = 1,
+	PSC_J_M = 6,
+	PSC_H_M = 10,
+	PSC_K_M = 14,
+	PSC_DIST_OPT = 51,
+};
+
+//their order in pscSpec
+enum {
+	COL_RA,
+	COL_DEC,
+	COL_J_M,
+	COL_H_M,
+	COL_K_M,
+	COL_DIST_OPT,
+};
+
 double dist(double magn, double zeroMagnFlux, double wavelength, double restFlux) {
 	double flux = zeroMagnFlux * pow(10., -.4 * magn) * 3e-16 / (wavelength * wavelength);
 	double fluxRatio = flux / restFlux;
@@ -127,12 +144,53 @@ double dist(double magn, double zeroMagnFlux, double wavelength, double restFlux
 	return d;
 }
 
-void process(std::string const & srcfilename, std::string const & dstfilename) {
-	int numEntries = 0;
-	int numReadable = 0;
+IngestSpec pscSpec() {
+	IngestSpec spec;
+	spec.delim = '|';
+	spec.column(PSC_RA, INGEST_NUMBER, INGEST_RA, "ra")
+		.column(PSC_DEC, INGEST_NUMBER, INGEST_DEC, "dec")
+		.column(PSC_J_M, INGEST_NUMBER, INGEST_MAGNITUDE, "j_m", false)
+		.column(PSC_H_M, INGEST_NUMBER, INGEST_MAGNITUDE, "h_m", false)
+		.column(PSC_K_M, INGEST_NUMBER, INGEST_MAGNITUDE, "k_m", false)
+		.column(PSC_DIST_OPT, INGEST_NUMBER, INGEST_VALUE, "dist_opt", false);	//the row is still used without it
+
+	//photometric distance, averaged over whichever bands are there
+	spec.distance = [](const double *values, double &distance) {
+		double r = 0, rDensity = 0;
+		if (!std::isnan(values[COL_J_M])) {
+			r += dist(values[COL_J_M], 1594., 1.235, 3.129e-13);
+			rDensity++;
+		}
+		if (!std::isnan(values[COL_H_M])) {
+			r += dist(values[COL_H_M], 1024, 1.662, 1.133e-13);
+			rDensity++;
+		}
+		if (!std::isnan(values[COL_K_M])) {
+			r += dist(values[COL_K_M], 666.7, 2.159, 4.283e-14);
+			rDensity++;
+		}
 
-	std::ifstream srcfile(srcfilename);
-	if (!srcfile) throw Exception() << "failed to open file " << srcfilename;
+		double dist_opt = values[COL_DIST_OPT];
+		bool got_dist_opt = !std::isnan(dist_opt);
+		if (USE_DIST_OPT) {
+			if (!got_dist_opt) return false;
+			distance = 1. / dist_opt;
+		} else {
+			if (!rDensity) return false;
+			distance = r / rDensity;	//TODO weight by errors?
+		}
+
+		if (R_VS_DIST_OPT && got_dist_opt) {
+			std::cout << r << "\t" << (1./dist_opt) << std::endl;
+		}
+		return true;
+	};
+	return spec;
+}
+
+void process(std::string const & srcfilename, std::string const & dstfilename, std::string const & statsfilename) {
+	//same as what getstats would produce from the point file
+	StatSet pointStats;
 
 	std::ofstream dstfile;
 	if (!OMIT_WRITE) {
@@ -140,279 +198,55 @@ void process(std::string const & srcfilename, std::string const & dstfilename) {
 		if (!dstfile) throw Exception() << "failed to open file " << dstfilename;
 	}
 
-	int num_dist_opts = 0;
-	double ra_avg = 0;
-	double ra_sqavg = 0;
-	double ra_min = INFINITY;
-	double ra_max = -INFINITY;
-	double dec_avg = 0;
-	double dec_sqavg = 0;
-	double dec_min = INFINITY;
-	double dec_max = -INFINITY;
-
-	while (!srcfile.eof()) {
-		int i = 0;
-		double ra, dec;
-		double j_m, h_m, k_m, dist_opt;
-		double rad_dec, rad_ra;
-		double r = 0, rDensity = 0;
-		float vtx[3];
-		char line[4096];	
-		
-		getlinen(srcfile, line, sizeof(line));
-		
-		auto len = std::strlen(line);
-		if (len == sizeof(line)-1) throw Exception() << "line buffer overflow";
-		
-		if (VERBOSE) {
-			std::cout << "got length " << len << " line " << line << std::endl;
+	//files are already spread over the threads, so each one is read on one
+	IngestCounts counts = ingestFile(pscSpec(), srcfilename, [&](const vec3f &vtx, const double * /*values*/, const std::string * /*labels*/) {
+		if (!OMIT_WRITE) {
+			dstfile.write(reinterpret_cast<char const *>(&vtx), sizeof(vtx));
 		}
-		numEntries++;
-		
-		do {
-			char *v = std::strtok(line, "|"); if (!v) break;	//ra
-			if (VERBOSE) std::cout << "ra: " << v << std::endl; 
-			if (!sscanf(v, "%lf", &ra)) break;
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //dec
-			if (VERBOSE) std::cout << "dec: " << v << std::endl; 
-			if (!sscanf(v, "%lf", &dec)) break;
-
-			v = std::strtok(nullptr, "|"); if (!v) break; //err-maj
-			if (VERBOSE) std::cout << "err-maj: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //err-min
-			if (VERBOSE) std::cout << "err-min: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //err-ang
-			if (VERBOSE) std::cout << "err-ang: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //designation
-			if (VERBOSE) std::cout << "designation: " << v << std::endl; 
-
-			v = std::strtok(nullptr, "|"); if (!v) break; //j_m
-			if (VERBOSE) std::cout << "j_m: " << v << std::endl; 
-			if (sscanf(v, "%lf", &j_m)) {
-				r += dist(j_m, 1594., 1.235, 3.129e-13);
-				rDensity++;
-			}
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //j_csmig
-			if (VERBOSE) std::cout << "j_csmig: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //j_msigcom
-			if (VERBOSE) std::cout << "j_msigcom: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //j_snr
-			if (VERBOSE) std::cout << "j_snr: " << v << std::endl; 
-		
-			v = std::strtok(nullptr, "|"); if (!v) break; //h_m
-			if (VERBOSE) std::cout << "h_m: " << v << std::endl; 
-			if (sscanf(v, "%lf", &h_m)) {
-				r += dist(h_m, 1024, 1.662, 1.133e-13);
-				rDensity++;
-			}
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //h_csmig
-			if (VERBOSE) std::cout << "h_csmig: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //h_msigcom
-			if (VERBOSE) std::cout << "h_msigcom: " << v << std::endl; 
-			
-			v = std::strtok(nullptr, "|"); if (!v) break; //h_snr
-			if (VERBOSE) std::cout << "h_snr: " << v << std::endl; 
-		
-			v = std::strtok(nullptr, "|"); if (!v) break; //k_m
-			if (VERBOSE) std::cout << "k_m: " << v << std::endl; 
-			if (sscanf(v, "%lf", &k_m)) {
-				r += dist(k_m, 666.7, 2.159, 4.283e-14);
-				rDensity++;
-			}
-	
-			//look for dist_opt ...
-			int got_dist_opt = 0;
-			do {
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_cmsig
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_msigcom
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_snr
-				v = std::strtok(nullptr, "|"); if (!v) break;	///ph_qual
-				v = std::strtok(nullptr, "|"); if (!v) break;	///rd_flg
-				v = std::strtok(nullptr, "|"); if (!v) break;	///bl_flg
-				v = std::strtok(nullptr, "|"); if (!v) break;	///cc_flg
-				v = std::strtok(nullptr, "|"); if (!v) break;	///ndet
-				v = std::strtok(nullptr, "|"); if (!v) break;	///prox
-				v = std::strtok(nullptr, "|"); if (!v) break;	///pxpa
-				v = std::strtok(nullptr, "|"); if (!v) break;	///pxcntr
-				v = std::strtok(nullptr, "|"); if (!v) break;	///gal_contam
-				v = std::strtok(nullptr, "|"); if (!v) break;	///mp_flg
-				v = std::strtok(nullptr, "|"); if (!v) break;	///pts_key/cntr
-				v = std::strtok(nullptr, "|"); if (!v) break;	///hemis
-				v = std::strtok(nullptr, "|"); if (!v) break;	///date
-				v = std::strtok(nullptr, "|"); if (!v) break;	///scan
-				v = std::strtok(nullptr, "|"); if (!v) break;	///glon
-				v = std::strtok(nullptr, "|"); if (!v) break;	///glat
-				v = std::strtok(nullptr, "|"); if (!v) break;	///x_scan
-				v = std::strtok(nullptr, "|"); if (!v) break;	///jdate
-				v = std::strtok(nullptr, "|"); if (!v) break;	///j_psfchi
-				v = std::strtok(nullptr, "|"); if (!v) break;	///h_psfchi
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_psfchi
-				v = std::strtok(nullptr, "|"); if (!v) break;	///j_m_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///j_msig_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///h_m_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///h_msig_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_m_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///k_msig_stdap
-				v = std::strtok(nullptr, "|"); if (!v) break;	///dist_edge_ns
-				v = std::strtok(nullptr, "|"); if (!v) break;	///dist_edge_ew
-				v = std::strtok(nullptr, "|"); if (!v) break;	///dist_edge_flg
-				v = std::strtok(nullptr, "|"); if (!v) break;	///dup_src
-				v = std::strtok(nullptr, "|"); if (!v) break;	///use_src
-				v = std::strtok(nullptr, "|"); if (!v) break;	///a
-				v = std::strtok(nullptr, "|"); if (!v) break;	///dist_opt
-				got_dist_opt = sscanf(v, "%lf", &dist_opt);
-#if 0	
-				v = std::strtok(nullptr, "|"); if (!v) break;	///phi_opt
-				v = std::strtok(nullptr, "|"); if (!v) break;	///b_m_opt
-				v = std::strtok(nullptr, "|"); if (!v) break;	///vr_m_opt
-				v = std::strtok(nullptr, "|"); if (!v) break;	///nopt_mchs
-				v = std::strtok(nullptr, "|"); if (!v) break;	///ext_key
-				v = std::strtok(nullptr, "|"); if (!v) break;	///scan_key
-				v = std::strtok(nullptr, "|"); if (!v) break;	///coadd_key
-				v = std::strtok(nullptr, "|"); if (!v) break;	///coadd
-#endif
-			} while (0);
-			if (got_dist_opt) num_dist_opts++;
-
-			double usingR;
-			if (USE_DIST_OPT) {
-				if (!got_dist_opt) break;
-				usingR = 1. / dist_opt;	
-			} else {
-				if (!rDensity) break;
-				usingR = r / rDensity;
-			}
-			
-			if (R_VS_DIST_OPT && got_dist_opt) {
-				std::cout << r << "\t" << (1./dist_opt) << std::endl;
-			}
-			double rad_ra = ra * M_PI / 180.0;
-			double rad_dec = dec * M_PI / 180.0;
-			double cos_dec = cos(rad_dec);
-			vtx[0] = (float)(usingR * cos(rad_ra) * cos_dec);
-			vtx[1] = (float)(usingR * sin(rad_ra) * cos_dec);
-			vtx[2] = (float)(usingR * sin(rad_dec));
-			if (VERBOSE) {
-				std::cout << " -- calculated values -- " << std::endl;
-				std::cout
-					<< "ra " << ra
-					<< "dec" << dec
-					<< "j_m" << j_m
-					<< "h_m" << h_m
-					<< "k_m" << k_m
-					<< "r" << r
-					<< "rDensity" << rDensity	//TODO weight by errors?
-					<< "1/dist_opt" << (got_dist_opt ? 1./dist_opt : NAN)
-					<< "rad_ra" << rad_ra
-					<< "rad_dec" << rad_dec
-					<< "x" << vtx[0]
-					<< "y" << vtx[1]
-					<< "z" << vtx[2]
-					<< std::endl
-				;
-			}
-			if (!std::isnan(vtx[0]) && !std::isnan(vtx[1]) && !std::isnan(vtx[2])
-				&& vtx[0] != INFINITY && vtx[0] != -INFINITY 
-				&& vtx[1] != INFINITY && vtx[1] != -INFINITY 
-				&& vtx[2] != INFINITY && vtx[2] != -INFINITY
-			) {
-				//inc before use in moving avg
-				numReadable++;
-				
-				if (ra < ra_min) ra_min = ra;
-				if (ra > ra_max) ra_max = ra;
-				ra_avg += (ra - ra_avg) / (double)numReadable;
-				ra_sqavg += (ra*ra - ra_sqavg) / (double)numReadable;
-				if (dec < dec_min) dec_min = dec;
-				if (dec > dec_max) dec_max = dec;
-				dec_avg += (dec - dec_avg) / (double)numReadable;
-				dec_sqavg += (dec*dec - dec_sqavg) / (double)numReadable;
-				
-				if (!OMIT_WRITE) {
-					if (VERBOSE) {
-						std::cout << "writing..." << std::endl;
-					}
-					dstfile.write(reinterpret_cast<char const *>(vtx), sizeof(vtx));
-				}
-			}
-
-			if (INTERACTIVE) {
-				if (getchar() == 'q') {
-					exit(0);	
-				}
+		if (WRITE_STATS) {
+			pointStats.accumPoint(vtx.x, vtx.y, vtx.z);
+		}
+		if (INTERACTIVE) {
+			if (getchar() == 'q') {
+				exit(0);
 			}
-		} while (0);
-	}
+		}
+	}, 1, VERBOSE);
 
 	std::cout 
-		<< "num entries: " << numEntries
-		<< "num readable entries: " << numReadable
-		<< "num dist_opts: " << num_dist_opts 
+		<< "num entries: " << counts.numEntries
+		<< "num readable entries: " << counts.numReadable
+		<< "num dist_opts: " << counts.numParsed[COL_DIST_OPT]
 		<< std::endl
 	;
-#if 0	//now in getstats
-	if (numReadable) {
-		double ra_stddev = sqrt(ra_sqavg - ra_avg * ra_avg);
-		double dec_stddev = sqrt(dec_sqavg - dec_avg * dec_avg);
-		std::cout 
-			<< "ra min " << ra_min
-			<< " max "  << ra_max
-			<< " avg "  << ra_avg
-			<< " stddev "  << ra_stddev
-			<< std::endl
-			<< "dec min " << dec_min
-			<< " max "  << dec_max
-			<< " avg "  << dec_avg
-			<< " stddev " << dec_stddev
-			<< std::endl
-		;
+
+	if (WRITE_STATS) {
+		pointStats.calcStdDev();
+		pointStats.write(statsfilename);
 	}
-#endif
 }
 
 void runOnGZip(const char *basename) {
 	std::string dstname = std::string() + "datasets/allsky/points/" + basename + ".f32";
+	std::string statsname = std::string() + "datasets/allsky/stats/" + basename + ".stats";
 
 	if (!FORCE && std::filesystem::exists(dstname)) {
 		std::cout << "file " << dstname << " already exists" << std::endl;
 		return;
 	}
 
-	std::string rawname = std::string() + "datasets/allsky/raw/" + basename;
-
-	if (!std::filesystem::exists(rawname)) {
-		std::string cmd = std::string() + "7z x -odatasets/allsky/raw datasets/allsky/source/" + basename + ".gz";
-		std::cout << "extracting " << cmd << std::endl;
-		int code = std::system(cmd.c_str());
-		if (code) {
-			throw Exception() << cmd << " failed with error code " << code;
-		}
-	}
+	std::string srcname = std::string() + "datasets/allsky/source/" + basename + ".gz";
 	
 	//for all files named psc_???.gz
-	std::cout << "processing " << rawname << std::endl;;
-	process(rawname, dstname);
-
-	if (!PRESERVE) {
-		std::cout << "deleting " << rawname << std::endl;
-		if (!std::filesystem::remove(rawname)) throw Exception() << "failed to delete file " << rawname;
-	}
+	std::cout << "processing " << srcname << std::endl;;
+	process(srcname, dstname, statsname);
 }
 
 struct ConvertWorker {
 	typedef std::string ArgType;
 	std::string desc(const std::string &basename) { return std::string() + "file " + basename; }
 
-	ConvertWorker(BatchProcessor<ConvertWorker> *batch_) {} 
+	ConvertWorker(BatchProcessor<ConvertWorker> * /*batch_*/) {}
 	
 	void operator()(const std::string &basename) {
 		runOnGZip(basename.c_str());
@@ -428,13 +262,10 @@ void _main(std::vector<std::string> const & args) {
 		{"--verbose", {"= shows verbose information.", {[&](){
 			VERBOSE = true;
 		}}}},
-		{"--wait", {"= waits for key at each entry.  implies verbose.", {[&](){
+		{"--wait", {"= waits for key at each readable entry.  implies verbose.", {[&](){
 			VERBOSE = true;
 			INTERACTIVE = true;
 		}}}},
-		{"--keep", {"= keep the extracted file after unzipping.", {[&](){
-			PRESERVE = true;
-		}}}},
 		{"--nowrite", {"= do not write f32 file.  useful for verbose.", {[&](){
 			OMIT_WRITE = true;
 		}}}},
@@ -455,6 +286,9 @@ void _main(std::vector<std::string> const & args) {
 		{"--force", {"= run even if the destination file exists.", {[&](){
 			FORCE = true;
 		}}}},
+		{"--write-stats", {"= also write datasets/allsky/stats/<file>.stats, same as getstats would.", {[&](){
+			WRITE_STATS = true;
+		}}}},
 		{"--threads", {"<n> = specify the number of threads to use.", {std::function<void(int)>([&](int n){
 			batch.setNumThreads(n);
 		})}}},
@@ -467,7 +301,7 @@ void _main(std::vector<std::string> const & args) {
 	}
 
 	if (gotDir) {
-		for (auto const & i : getDirFileNames(std::string() + "datasets/allsky/points")) {
+		for (auto const & i : getDirFileNames(std::string() + "datasets/allsky/source")) {
 			std::string base, ext;
 			getFileNameParts(i, base, ext);
 			if (ext == "gz") {
@@ -478,7 +312,7 @@ void _main(std::vector<std::string> const & args) {
 	}
 
 	std::filesystem::create_directory("datasets/allsky/points");
-	std::filesystem::create_directory("datasets/allsky/raw");
+	if (WRITE_STATS) std::filesystem::create_directory("datasets/allsky/stats");
 
 	double deltaTime = profile("batch", [&](){
 		batch();
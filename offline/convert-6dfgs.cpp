@@ -1,105 +1,81 @@
-#include <cstring>
-#include <cmath>		//std::isnan
 #include <filesystem>
 #include "exception.h"
 #include "util.h"
+#include "stat.h"
+#include "ingest.h"
+
+bool writeStats = false;
 
 struct Convert6DFGS {
+	int numThreads = 0;
+
 	void operator()() {
 		const char *srcfilename = "datasets/6dfgs/source/6dFGSzDR3.txt";
 		const char *dstfilename = "datasets/6dfgs/points/points.f32";	
-		int numEntries = 0;
-		int numReadable = 0;
 
 		std::filesystem::create_directory("datasets/6dfgs/points");
 
-		std::ifstream srcfile(srcfilename);
-		if (!srcfile) throw Exception() << "failed to open file " << srcfilename;
-
 		std::ofstream dstfile(dstfilename, std::ios::binary);
 		if (!dstfile) throw Exception() << "failed to open file " << dstfilename;
-		
-		while (!srcfile.eof()) {
-			double lon, lat, redshift;
-			float vtx[3];
-			char line[4096];	
-			getlinen(srcfile, line, sizeof(line));
-			int const len = strlen(line);
-			if (!len) continue;
-			if (len == sizeof(line)-1) throw Exception() << "line buffer overflow";
-			if (line[0] == '#') continue;
-			numEntries++;
 
-			do {
-				char *v = strtok(line, " "); if (!v) break;	//ID
-				v = strtok(nullptr, " "); if (!v) break; //R.A. hrs
-				v = strtok(nullptr, " "); if (!v) break; //R.A. min 
-				v = strtok(nullptr, " "); if (!v) break; //R.A. sec 
-				v = strtok(nullptr, " "); if (!v) break; //Dec. deg 
-				v = strtok(nullptr, " "); if (!v) break; //Dec. min 
-				v = strtok(nullptr, " "); if (!v) break; //Dec. sec 
-				v = strtok(nullptr, " "); if (!v) break; //# measurements
-				v = strtok(nullptr, " "); if (!v) break; //# measurements used in final cz
-				v = strtok(nullptr, " "); if (!v) break; //recalibrated b_J magnitude
-				v = strtok(nullptr, " "); if (!v) break; //programme ID number
-				v = strtok(nullptr, " "); if (!v) break; //recalibrated r_F magnitude
-				v = strtok(nullptr, " "); if (!v) break; //SuperCOSMOS classifier: 1 = galaxy, 2 = star, 3 = unclassifiable, 4 = noise
-				v = strtok(nullptr, " "); if (!v) break; //sum of comparison flags
-				v = strtok(nullptr, " "); if (!v) break; //best redshift
-				if (!sscanf(v, "%lf", &redshift)) break;
-				
-				v = strtok(nullptr, " "); if (!v) break; //combined uncertainty
-				v = strtok(nullptr, " "); if (!v) break; //code identifying source of redshift
-				v = strtok(nullptr, " "); if (!v) break; //best redshift quality value
-				
-				v = strtok(nullptr, " "); if (!v) break; //galactic latitude
-				if (!sscanf(v, "%lf", &lat)) break;
-				
-				v = strtok(nullptr, " "); if (!v) break; //galacitic longitude
-				if (!sscanf(v, "%lf", &lon)) break;
-				
-				v = strtok(nullptr, " "); if (!v) break; //galactic extinction in V magnitudes
-				v = strtok(nullptr, " "); if (!v) break; //weight source had for first round
-				v = strtok(nullptr, " "); if (!v) break; // TARGETID number from the 6dFGS database
-				v = strtok(nullptr, " "); if (!v) break; //template does
-				v = strtok(nullptr, " "); if (!v) break; //name of redshift field file
-				v = strtok(nullptr, " "); if (!v) break; //SPECID
+		//same as what getstats would produce from the point file
+		StatSet pointStats;
 
-				//printf("%f %f %f\n", lon, lat, redshift);
-				//continue;
+		/*
+		fields, space-aligned:
+		ID, R.A. hrs min sec, Dec. deg min sec, # measurements, # measurements used in final cz,
+		recalibrated b_J magnitude, programme ID number, recalibrated r_F magnitude,
+		SuperCOSMOS classifier (1 = galaxy, 2 = star, 3 = unclassifiable, 4 = noise), sum of comparison flags,
+		best redshift, combined uncertainty, code identifying source of redshift, best redshift quality value,
+		galactic latitude, galactic longitude, galactic extinction in V magnitudes, weight source had for first round,
+		TARGETID number from the 6dFGS database, template does, name of redshift field file, SPECID
+		*/
+		IngestSpec spec;
+		spec.delim = ' ';
+		spec.mergeDelims = true;
+		spec.comment = '#';
+		spec.hubbleConstant = 69.32;	//km/s/Mpc
+		//spec.hubbleConstant *= 26.99150576602659;	//ehh, calibratingn for andromeda's distance ... is that andromeda? 
+		spec.column(14, INGEST_NUMBER, INGEST_REDSHIFT, "best redshift")
+			.column(18, INGEST_NUMBER, INGEST_LAT, "galactic latitude")
+			.column(19, INGEST_NUMBER, INGEST_LON, "galactic longitude")
+			.column(25, INGEST_STRING, INGEST_VALUE, "SPECID");	//only there so short rows are dropped
 
-				//galactic latitude and longitude are in degrees
-				double rad_ra = lon * M_PI / 180.0;
-				double rad_dec = lat * M_PI / 180.0;
-				double cos_dec = cos(rad_dec);
-				//redshift is in km/s
-				double H0 = 69.32;	//km/s/Mpc
-				//H0 *=26.99150576602659;	//ehh, calibratingn for andromeda's distance ... is that andromeda? 
-				//distance is in Mpc
-				double distance = redshift / H0;
-				vtx[0] = (float)(distance * cos(rad_ra) * cos_dec);
-				vtx[1] = (float)(distance * sin(rad_ra) * cos_dec);
-				vtx[2] = (float)(distance * sin(rad_dec));
+		IngestCounts counts = ingestFile(spec, srcfilename, [&](const vec3f &vtx, const double * /*values*/, const std::string * /*labels*/) {
+			dstfile.write(reinterpret_cast<char const *>(&vtx), sizeof(vtx));
+			if (writeStats) {
+				pointStats.accumPoint(vtx.x, vtx.y, vtx.z);
+			}
+		}, numThreads);
 
-				if (!std::isnan(vtx[0]) && !std::isnan(vtx[1]) && !std::isnan(vtx[2])
-					&& vtx[0] != INFINITY && vtx[0] != -INFINITY 
-					&& vtx[1] != INFINITY && vtx[1] != -INFINITY 
-					&& vtx[2] != INFINITY && vtx[2] != -INFINITY
-				) {
-					numReadable++;
-					dstfile.write(reinterpret_cast<char const *>(vtx), sizeof(vtx));
-				}
-			} while (0);
-		}
+		std::cout << "num entries: " << counts.numEntries << std::endl;
+		std::cout << "num readable: " << counts.numReadable << std::endl;
 
-		std::cout << "num entries: " << numEntries << std::endl;
-		std::cout << "num readable: " << numReadable << std::endl;
+		if (writeStats) {
+			std::filesystem::create_directory("datasets/6dfgs/stats");
+			pointStats.calcStdDev();
+			pointStats.write("datasets/6dfgs/stats/points.stats");
+		}
 	}
 };
 
-int main() {
-	profile("convert-6dfgs", [](){
-		Convert6DFGS convert;
+void _main(std::vector<std::string> const & args) {
+	Convert6DFGS convert;
+	HandleArgs(args, {
+		{"--write-stats", {"= also write datasets/6dfgs/stats/points.stats, same as getstats would", {[&](){ writeStats = true; }}}},
+		{"--threads", {"<n> = specify the number of threads to use.", {std::function<void(int)>([&](int n){ convert.numThreads = n; })}}},
+	});
+	profile("convert-6dfgs", [&](){
 		convert();
 	});
 }
+
+int main(int argc, char** argv) {
+	try {
+		_main({argv, argv + argc});
+	} catch (std::exception & t) {
+		std::cerr << "error: " << t.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -17,6 +17,7 @@ bool getColumns = false;
 bool interactive = false;
 bool omitWrite = false;
 bool showRanges = false;
+bool writeStats = false;
 bool outputExtra = false;
 bool keepNegativeParallax = false;
 
@@ -53,7 +54,8 @@ struct ConvertSDSS {
 		//mkdir("datasets/gaia", 0775);
 		std::filesystem::create_directory("datasets/gaia/points");
 
-		std::string pointDestFileName = std::string() + "datasets/gaia/points/points" + (outputExtra ? "-9col" : "") + "." + getOutputExt();
+		std::string pointDestBaseName = std::string() + "points" + (outputExtra ? "-9col" : "");
+		std::string pointDestFileName = std::string() + "datasets/gaia/points/" + pointDestBaseName + "." + getOutputExt();
 
 		std::ofstream pointDestFile;
 		if (!omitWrite) {
@@ -81,6 +83,9 @@ struct ConvertSDSS {
 		//derived:
 		Stat stat_distance;
 
+		//same as what getstats would produce from the point file
+		StatSet pointStats;
+
 		//TODO assert columns are of the type  matching what I will be reading
 
 		OutputPrecision position[3], velocity[3], radius, temp, luminosity;
@@ -333,6 +338,10 @@ struct ConvertSDSS {
 								stat_vz.accum(velocity[2], numReadable);
 							}
 						}
+
+						if (writeStats) {
+							pointStats.accumPoint(position[0], position[1], position[2]);
+						}
 						
 						if (!omitWrite) {
 							pointDestFile.write(reinterpret_cast<char const *>(position), sizeof(position));
@@ -365,6 +374,12 @@ struct ConvertSDSS {
 		}
 
 		std::cout << "num readable: " << numReadable << std::endl;
+
+		if (writeStats) {
+			std::filesystem::create_directory("datasets/gaia/stats");
+			pointStats.calcStdDev();
+			pointStats.write(std::string() + "datasets/gaia/stats/" + pointDestBaseName + ".stats");
+		}
 	
 		if (showRanges) {
 			std::cout 
@@ -396,6 +411,7 @@ void _main(std::vector<std::string> const & args) {
 	HandleArgs(args, {
 		{"--verbose", {"= output values", {[&](){ verbose = true; }}}},
 		{"--show-ranges", {"= show ranges of certain fields", {[&](){ showRanges = true; }}}},
+		{"--write-stats", {"= also write datasets/gaia/stats/<name>.stats, same as getstats would.  only for the default 3 float output, since that's all getstats reads", {[&](){ writeStats = true; }}}},
 		{"--wait", {"= wait for keypress after each entry.  'q' stops", {[&](){ verbose = true; interactive = true; }}}},
 		{"--get-columns", {"= print all column names", {[&](){ getColumns = true; }}}},
 		{"--nowrite", {"= don't write results.  useful with --verbose or --read-desc", {[&](){ omitWrite = true; }}}},
@@ -405,6 +421,8 @@ void _main(std::vector<std::string> const & args) {
 		{"--designations", {"= make a map file of designations.", {[&](){ makeDesignations = true; }}}},
 	});
 
+	if (writeStats && (useDouble || outputExtra)) throw Exception() << "--write-stats only works with the default 3 float output, not --double or --output-extra";
+
 	if (!useDouble) {
 		profile("convert-gaia", [&](){ 
 			ConvertSDSS<float> convert;
@@ -27,6 +27,7 @@ bool readStringDescs = false;
 bool trackStrings = false;
 bool omitWrite = false;
 bool showRanges = false;
+bool writeStats = false;
 
 //notice: "Visualization of large scale structure from the Sloan Digital Sky Survey" by M U SubbaRao, M A Aragón-Calvo, H W Chen, J M Quashnock, A S Szalay and D G York in New Journal of Physics
 // samples redshift from 0.01 < z < 0.11
@@ -269,6 +270,12 @@ struct ConvertSDSS3 {
 			}
 		}	
 
+		//same as what getstats would produce from the point file
+		StatSet pointStats;
+		if (writeStats && spherical) {
+			std::cout << "--write-stats only applies to xyz output.  not writing stats." << std::endl;
+		}
+
 		//non spherical
 		Stat stat_cx, stat_cy, stat_cz;
 		
@@ -358,6 +365,10 @@ struct ConvertSDSS3 {
 						stat_cy.accum(value_CY, numReadable);
 						stat_cz.accum(value_CZ, numReadable);
 					}
+
+					if (writeStats) {
+						pointStats.accumPoint(vtx[0], vtx[1], vtx[2]);
+					}
 					
 					if (!omitWrite) {
 						pointDestFile.write(reinterpret_cast<char const *>(vtx), sizeof(vtx));
@@ -422,6 +433,12 @@ struct ConvertSDSS3 {
 		fitsSafe(fits_close_file, file);
 		
 		std::cout << "num readable: " << numReadable << std::endl;
+
+		if (writeStats && !spherical) {
+			std::filesystem::create_directory("datasets/sdss/stats");
+			pointStats.calcStdDev();
+			pointStats.write("datasets/sdss/stats/points.stats");
+		}
 	
 		if (showRanges) {
 			std::cout 
@@ -450,6 +467,7 @@ void _main(std::vector<std::string> const & args) {
 		{"--verbose", {"= output values", {[&](){ verbose = true; }}}},
 		{"--wait", {"= wait for keypress after each entry.  'q' stops", {[&](){ verbose = true; interactive = true; }}}},
 		{"--show-ranges", {"= show ranges of certain fields", {[&](){ showRanges = true; }}}},
+		{"--write-stats", {"= also write datasets/sdss/stats/points.stats, same as getstats would", {[&](){ writeStats = true; }}}},
 		{"--read-desc", {"= reads string descriptions", {[&](){ readStringDescs = true; }}}},
 		{"--min-redshift", {"= <cz> specify minimum redshift", {std::function<void(float)>([&](float x){ useMinRedshift = true; minRedshift = x; })}}},
 		{"--enum-class", {"= enumerate all classes", {[&](){ trackStrings = true; }}}},
@@ -250,9 +250,19 @@ if not path'datasets/simbad/catalog.specs':exists() then
 			end
 		end
 	end
-	path'datasets/simbad/catalog.specs':write(tolua(colmaxs))
+	-- name=width lines in column order, like convert-2mrs writes and catalog_specs.lua and index-catalog read
+	path'datasets/simbad/catalog.specs':write(cols:map(function(col)
+		return col..'='..colmaxs[col]..'\n'
+	end):concat())
 else
-	colmaxs = assert(fromlua(path'datasets/simbad/catalog.specs':read()), "failed to load colmaxs")
+	colmaxs = table()
+	for line in io.lines'datasets/simbad/catalog.specs' do
+		if #line > 0 then
+			local k,v = line:match'(.-)=(.*)'
+			assert(k and tonumber(v), "got a bad line in datasets/simbad/catalog.specs: "..line)
+			colmaxs[k] = tonumber(v)
+		end
+	end
 end
 
 if not path'datasets/simbad/catalog.dat':exists() then
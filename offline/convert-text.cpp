@@ -0,0 +1,136 @@
+/*
+converts any delimited text catalog into a point file, given which columns hold what.
+for surveys that don't need anything more than that, instead of another convert-* tool.
+
+ex, the 6dfgs points:
+convert-text --src datasets/6dfgs/source/6dFGSzDR3.txt --set 6dfgs --delim space --comment '#' --column 14:redshift --column 18:lat --column 19:lon --column 25:text
+*/
+#include <filesystem>
+#include <map>
+#include "exception.h"
+#include "util.h"
+#include "stat.h"
+#include "ingest.h"
+
+struct ConvertText {
+	std::string srcfilename;
+	std::string setname;
+	IngestSpec spec;
+	bool writeStats = false;
+	bool verbose = false;
+	int numThreads = 0;
+
+	//index:role, or index:role:name.  a trailing ? on the role makes the column optional
+	void addColumn(std::string const & s) {
+		static const std::map<std::string, std::pair<IngestColumnType, IngestColumnRole>> roles = {
+			{"ra", {INGEST_NUMBER, INGEST_RA}},
+			{"dec", {INGEST_NUMBER, INGEST_DEC}},
+			{"lon", {INGEST_NUMBER, INGEST_LON}},
+			{"lat", {INGEST_NUMBER, INGEST_LAT}},
+			{"redshift", {INGEST_NUMBER, INGEST_REDSHIFT}},
+			{"magnitude", {INGEST_NUMBER, INGEST_MAGNITUDE}},
+			{"value", {INGEST_NUMBER, INGEST_VALUE}},
+			{"text", {INGEST_STRING, INGEST_VALUE}},	//only checked for, ex. so short rows are dropped
+		};
+
+		size_t colon = s.find(':');
+		if (colon == std::string::npos) throw Exception() << "expected index:role, got " << s;
+		int index;
+		if (sscanf(s.substr(0, colon).c_str(), "%d", &index) != 1) throw Exception() << "expected a column index, got " << s;
+		std::string role = s.substr(colon + 1);
+		std::string name;
+		size_t colon2 = role.find(':');
+		if (colon2 != std::string::npos) {
+			name = role.substr(colon2 + 1);
+			role = role.substr(0, colon2);
+		}
+		bool required = true;
+		if (!role.empty() && role.back() == '?') {
+			required = false;
+			role.pop_back();
+		}
+		auto i = roles.find(role);
+		if (i == roles.end()) throw Exception() << "unknown role " << role;
+		if (name.empty()) name = role;
+		spec.column(index, i->second.first, i->second.second, name, required);
+	}
+
+	static char parseDelim(std::string const & s) {
+		if (s == "space") return ' ';
+		if (s == "tab") return '\t';
+		if (s.size() != 1) throw Exception() << "expected a single character, space, or tab, got " << s;
+		return s[0];
+	}
+
+	void operator()() {
+		if (srcfilename.empty()) throw Exception() << "expected --src";
+		if (setname.empty()) throw Exception() << "expected --set";
+
+		std::string pointDir = std::string() + "datasets/" + setname + "/points";
+		std::string dstfilename = pointDir + "/points.f32";
+		std::filesystem::create_directories(pointDir);
+
+		std::ofstream dstfile(dstfilename, std::ios::binary);
+		if (!dstfile) throw Exception() << "failed to open file " << dstfilename;
+
+		//same as what getstats would produce from the point file
+		StatSet pointStats;
+
+		IngestCounts counts = ingestFile(spec, srcfilename, [&](const vec3f &vtx, const double * /*values*/, const std::string * /*labels*/) {
+			dstfile.write(reinterpret_cast<char const *>(&vtx), sizeof(vtx));
+			if (writeStats) {
+				pointStats.accumPoint(vtx.x, vtx.y, vtx.z);
+			}
+		}, numThreads, verbose);
+
+		std::cout << "num entries: " << counts.numEntries << std::endl;
+		std::cout << "num readable: " << counts.numReadable << std::endl;
+		for (size_t i = 0; i < spec.columns.size(); i++) {
+			if (spec.columns[i].type == INGEST_NUMBER) {
+				std::cout << "num " << spec.columns[i].name << ": " << counts.numParsed[i] << std::endl;
+			}
+		}
+
+		if (writeStats) {
+			std::string statsDir = std::string() + "datasets/" + setname + "/stats";
+			std::filesystem::create_directory(statsDir);
+			pointStats.calcStdDev();
+			pointStats.write(statsDir + "/points.stats");
+		}
+	}
+};
+
+void _main(std::vector<std::string> const & args) {
+	ConvertText convert;
+	auto h = HandleArgs(args, {
+		{"--src", {"<file> = text catalog to read.  .gz is decompressed as it's read", {[&](std::string s){ convert.srcfilename = s; }}}},
+		{"--set", {"<name> = writes datasets/<name>/points/points.f32", {[&](std::string s){ convert.setname = s; }}}},
+		{"--delim", {"<c> = field delimiter, a character or space or tab.  default is |", {[&](std::string s){ convert.spec.delim = ConvertText::parseDelim(s); }}}},
+		{"--merge-delims", {"= runs of delimiters count as one, for space-aligned tables.  on by default for --delim space", {[&](){ convert.spec.mergeDelims = true; }}}},
+		{"--comment", {"<c> = skip lines starting with this character", {[&](std::string s){ convert.spec.comment = ConvertText::parseDelim(s); }}}},
+		{"--column", {"<index>:<role>[:name] = field index from 0, and one of ra dec lon lat redshift magnitude value text.  append ? to the role for optional.", {[&](std::string s){ convert.addColumn(s); }}}},
+		{"--hubble", {"<H0> = km/s/Mpc for redshift distances", {std::function<void(double)>([&](double x){ convert.spec.hubbleConstant = x; })}}},
+		{"--write-stats", {"= also write datasets/<name>/stats/points.stats, same as getstats would", {[&](){ convert.writeStats = true; }}}},
+		{"--verbose", {"= print each row's columns.  runs on one thread.", {[&](){ convert.verbose = true; }}}},
+		{"--threads", {"<n> = specify the number of threads to use.", {std::function<void(int)>([&](int n){ convert.numThreads = n; })}}},
+	});
+	if (convert.spec.delim == ' ') convert.spec.mergeDelims = true;
+	if (convert.srcfilename.empty() || convert.setname.empty() || convert.spec.columns.empty()) {
+		std::cout << "expected --src, --set, and --column" << std::endl;
+		h.showhelp();
+		return;
+	}
+	profile("convert-text", [&](){
+		convert();
+	});
+}
+
+int main(int argc, char** argv) {
+	try {
+		_main({argv, argv + argc});
+	} catch (std::exception & t) {
+		std::cerr << "error: " << t.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
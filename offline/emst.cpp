@@ -0,0 +1,271 @@
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include <cmath>
+#include <cstring>	//std::memcmp
+
+#include "emst.h"
+#include "fof.h"	//UnionFind
+#include "batch.h"
+#include "exception.h"
+
+const char EmstFileHeader::signature[4] = {'E', 'M', 'S', 'T'};
+
+namespace {
+
+struct KdNode {
+	float min[3], max[3];
+	int begin, end;	//range in KdTree::order
+	int left, right;	//-1 for leaves
+};
+
+struct KdTree {
+	static constexpr int leafSize = 16;
+
+	const vec3f *vtxs;
+	std::vector<int> order;
+	std::vector<KdNode> nodes;	//nodes[0] is the root, children come after their parent
+
+	KdTree(const vec3f *vtxs_, int numVtxs) : vtxs(vtxs_), order(numVtxs) {
+		for (int i = 0; i < numVtxs; i++) order[i] = i;
+		if (numVtxs) build(0, numVtxs);
+	}
+
+	//split on the widest axis at the median
+	int build(int begin, int end) {
+		int index = (int)nodes.size();
+		nodes.push_back(KdNode());
+		KdNode node;
+		node.begin = begin;
+		node.end = end;
+		node.left = node.right = -1;
+		for (int k = 0; k < 3; k++) {
+			node.min[k] = std::numeric_limits<float>::infinity();
+			node.max[k] = -std::numeric_limits<float>::infinity();
+		}
+		for (int i = begin; i < end; i++) {
+			const vec3f &v = vtxs[order[i]];
+			for (int k = 0; k < 3; k++) {
+				node.min[k] = std::min(node.min[k], v(k));
+				node.max[k] = std::max(node.max[k], v(k));
+			}
+		}
+		if (end - begin > leafSize) {
+			int axis = 0;
+			for (int k = 1; k < 3; k++) {
+				if (node.max[k] - node.min[k] > node.max[axis] - node.min[axis]) axis = k;
+			}
+			int mid = (begin + end) / 2;
+			std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+				return vtxs[a](axis) < vtxs[b](axis);
+			});
+			node.left = build(begin, mid);
+			node.right = build(mid, end);
+		}
+		nodes[index] = node;
+		return index;
+	}
+
+	double boxDistSq(const KdNode &node, const vec3f &v) const {
+		double d = 0;
+		for (int k = 0; k < 3; k++) {
+			double e = std::max(0., std::max((double)node.min[k] - v(k), (double)v(k) - node.max[k]));
+			d += e * e;
+		}
+		return d;
+	}
+};
+
+//candidate edges are compared by (length, a, b) so every round picks the same edges however the work is split
+struct Candidate {
+	double distSq;
+	int a, b;	//a < b
+
+	bool operator<(const Candidate &o) const {
+		if (distSq != o.distSq) return distSq < o.distSq;
+		if (a != o.a) return a < o.a;
+		return b < o.b;
+	}
+};
+
+struct BoruvkaBatchProcessor;
+
+struct BoruvkaWorker {
+	typedef int ArgType;	//part index
+	BoruvkaBatchProcessor &batch;
+	BoruvkaWorker(BatchProcessor<BoruvkaWorker> *batch_);
+	std::string desc(const ArgType &part);
+	void operator()(const ArgType &part);
+};
+
+struct BoruvkaBatchProcessor : public BatchProcessor<BoruvkaWorker> {
+	const KdTree &tree;
+	std::vector<int> comp;	//per vertex, its component's root
+	std::vector<int> nodeComp;	//per node, the component of all its points, or -1 if mixed
+	std::vector<std::unordered_map<int, Candidate>> partBests;	//per part, best outgoing edge per component
+	int round;
+
+	BoruvkaBatchProcessor(const KdTree &tree_, int numVtxs) : tree(tree_), comp(numVtxs), nodeComp(tree_.nodes.size()), round(0) {}
+
+	int numParts() const { return (int)threads.size(); }
+
+	//children come after their parents, so a reverse sweep is bottom up
+	void updateNodeComps() {
+		for (int n = (int)tree.nodes.size() - 1; n >= 0; n--) {
+			const KdNode &node = tree.nodes[n];
+			if (node.left == -1) {
+				int c = comp[tree.order[node.begin]];
+				for (int i = node.begin + 1; i < node.end; i++) {
+					if (comp[tree.order[i]] != c) {
+						c = -1;
+						break;
+					}
+				}
+				nodeComp[n] = c;
+			} else {
+				int c = nodeComp[node.left];
+				nodeComp[n] = c != -1 && c == nodeComp[node.right] ? c : -1;
+			}
+		}
+	}
+
+	//nearest vertex to i outside its component, improving on 'best'
+	void nearest(int n, int i, Candidate &best) const {
+		int c = comp[i];
+		if (nodeComp[n] == c) return;
+		const KdNode &node = tree.nodes[n];
+		const vec3f &v = tree.vtxs[i];
+		if (tree.boxDistSq(node, v) > best.distSq) return;
+		if (node.left == -1) {
+			for (int k = node.begin; k < node.end; k++) {
+				int j = tree.order[k];
+				if (comp[j] == c) continue;
+				double distSq = ((vec3d)tree.vtxs[j] - (vec3d)v).lenSq();
+				Candidate e = {distSq, std::min(i, j), std::max(i, j)};
+				if (e < best) best = e;
+			}
+			return;
+		}
+		//nearer child first
+		int first = node.left, second = node.right;
+		if (tree.boxDistSq(tree.nodes[second], v) < tree.boxDistSq(tree.nodes[first], v)) std::swap(first, second);
+		nearest(first, i, best);
+		nearest(second, i, best);
+	}
+};
+
+BoruvkaWorker::BoruvkaWorker(BatchProcessor<BoruvkaWorker> *batch_)
+: batch(*(BoruvkaBatchProcessor*)batch_)
+{}
+
+std::string BoruvkaWorker::desc(const ArgType &part) {
+	return std::string() + "round " + std::to_string(batch.round) + " part " + std::to_string(part);
+}
+
+void BoruvkaWorker::operator()(const ArgType &part) {
+	const KdTree &tree = batch.tree;
+	int n = (int)tree.order.size();
+	int begin = (int)((long)n * part / batch.numParts());
+	int end = (int)((long)n * (part + 1) / batch.numParts());
+	std::unordered_map<int, Candidate> &bests = batch.partBests[part];
+	//tree order keeps neighbours together, so consecutive points mostly share a component and its bound
+	for (int k = begin; k < end; k++) {
+		int i = tree.order[k];
+		int c = batch.comp[i];
+		auto found = bests.find(c);
+		Candidate best = {std::numeric_limits<double>::infinity(), -1, -1};
+		if (found != bests.end()) best = found->second;
+		batch.nearest(0, i, best);
+		if (best.a != -1) bests[c] = best;
+	}
+}
+
+}
+
+std::vector<EmstEdge> computeEMST(const vec3f *vtxs, int numVtxs, int numThreads) {
+	std::vector<EmstEdge> edges;
+	if (numVtxs < 2) return edges;
+	KdTree tree(vtxs, numVtxs);
+	BoruvkaBatchProcessor batch(tree, numVtxs);
+	if (numThreads > 0) batch.setNumThreads(numThreads);
+	UnionFind sets(numVtxs);
+	for (int i = 0; i < numVtxs; i++) batch.comp[i] = i;
+
+	while ((int)edges.size() < numVtxs - 1) {
+		++batch.round;
+		batch.updateNodeComps();
+		batch.partBests.clear();
+		batch.partBests.resize(batch.numParts());
+		for (int part = 0; part < batch.numParts(); part++) {
+			batch.addThreadArg(part);
+		}
+		batch();
+
+		std::unordered_map<int, Candidate> bests;
+		for (auto const & partBest : batch.partBests) {
+			for (auto const & p : partBest) {
+				auto found = bests.find(p.first);
+				if (found == bests.end() || p.second < found->second) bests[p.first] = p.second;
+			}
+		}
+		if (bests.empty()) throw Exception() << "emst round " << batch.round << " found no edges";
+		std::vector<Candidate> roundEdges;
+		for (auto const & p : bests) {
+			roundEdges.push_back(p.second);
+		}
+		std::sort(roundEdges.begin(), roundEdges.end());
+		for (Candidate const & e : roundEdges) {
+			//two components can pick the same edge
+			if (sets.merge(e.a, e.b)) {
+				edges.push_back(EmstEdge{(uint32_t)e.a, (uint32_t)e.b, e.distSq});
+			}
+		}
+		for (int i = 0; i < numVtxs; i++) {
+			batch.comp[i] = sets.find(i);
+		}
+	}
+
+	std::stable_sort(edges.begin(), edges.end(), [](const EmstEdge &a, const EmstEdge &b) {
+		return a.lengthSq < b.lengthSq;
+	});
+	return edges;
+}
+
+void writeEMST(std::string const & filename, int numVtxs, std::vector<EmstEdge> const & edges) {
+	std::ofstream f(filename, std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename << " for writing";
+	EmstFileHeader header = {};
+	std::memcpy(header.magic, EmstFileHeader::signature, sizeof(header.magic));
+	header.version = EmstFileHeader::currentVersion;
+	header.numVtxs = numVtxs;
+	header.numEdges = (uint32_t)edges.size();
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(edges.data()), sizeof(EmstEdge) * edges.size());
+	if (!f) throw Exception() << "failed to write " << filename;
+}
+
+std::vector<EmstEdge> readEMST(std::string const & filename, int numVtxs) {
+	std::ifstream f(filename, std::ios::in | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename;
+	EmstFileHeader header;
+	if (!f.read(reinterpret_cast<char*>(&header), sizeof(header))) throw Exception() << filename << " is too small";
+	if (std::memcmp(header.magic, EmstFileHeader::signature, sizeof(header.magic))) throw Exception() << filename << " is not an emst file";
+	if (header.version != EmstFileHeader::currentVersion) throw Exception() << filename << " has unknown version " << header.version;
+	if ((int)header.numVtxs != numVtxs) throw Exception() << filename << " is for " << header.numVtxs << " points, not " << numVtxs;
+	std::vector<EmstEdge> edges(header.numEdges);
+	if (!f.read(reinterpret_cast<char*>(edges.data()), sizeof(EmstEdge) * edges.size())) throw Exception() << filename << " is truncated";
+	return edges;
+}
+
+int cutEMST(std::vector<EmstEdge> const & edges, int numVtxs, double linkingLength, int *labels, std::vector<vec2i> &links) {
+	UnionFind sets(numVtxs);
+	//squared and in double, so a pair right at the linking length is cut the same way the merge tests would
+	double linkingLengthSq = linkingLength * linkingLength;
+	for (EmstEdge const & e : edges) {
+		if (e.lengthSq > linkingLengthSq) break;	//sorted
+		sets.merge(e.a, e.b);
+		links.push_back(vec2i(e.a, e.b));
+	}
+	return sets.labels(labels);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vec.h"
+
+/*
+euclidean minimum spanning tree.  mark-clusters --emst writes datasets/<set>/points/<base>.emst
+friends-of-friends with an isotropic linking length L is the same as keeping the tree edges no longer than L,
+so one tree answers every linking length with a linear-time cut.
+
+layout, little endian:
+	EmstFileHeader
+	EmstEdge [numEdges] -- sorted by length, shortest first
+
+it's a tree over every vertex, so numEdges is numVtxs-1.  coincident points get zero length edges.
+*/
+struct EmstFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numVtxs;
+	uint32_t numEdges;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 2;	//2 stores lengthSq as a double, 1 had a float length
+};
+
+struct EmstEdge {
+	uint32_t a, b;	//a < b
+	double lengthSq;	//|b - a|^2 of the points as doubles, the same number a friends-of-friends test compares against L^2
+};
+
+//borůvka over a k-d tree.  numThreads <= 0 uses the hardware concurrency.
+std::vector<EmstEdge> computeEMST(const vec3f *vtxs, int numVtxs, int numThreads);
+
+void writeEMST(std::string const & filename, int numVtxs, std::vector<EmstEdge> const & edges);
+std::vector<EmstEdge> readEMST(std::string const & filename, int numVtxs);
+
+//labels every vertex by its component after dropping edges with lengthSq > linkingLength^2.
+//labels are numbered in order of first vertex, like mark-clusters.  links gets the kept edges.  returns the # of clusters.
+int cutEMST(std::vector<EmstEdge> const & edges, int numVtxs, double linkingLength, int *labels, std::vector<vec2i> &links);
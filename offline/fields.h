@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstring>
+#include <charconv>
+#include <string_view>
+
+/*
+walks the delimited fields of a line in place.  no copies and no hidden state like strtok, so it's safe on several threads at once.
+fields are counted exactly: "a||b" has an empty field 1, where strtok would skip it.
+with mergeDelims, runs of delims count as one and leading and trailing ones are ignored, like strtok.  that's for space-aligned tables.
+*/
+struct FieldScanner {
+	const char *fieldBegin, *fieldEnd, *lineEnd;
+	char delim;
+	bool mergeDelims;
+	int index;
+
+	FieldScanner(const char *line, size_t length, char delim_, bool mergeDelims_ = false)
+	: fieldBegin(line), lineEnd(line + length), delim(delim_), mergeDelims(mergeDelims_), index(0) {
+		if (mergeDelims) {
+			fieldBegin = skipDelims(fieldBegin);
+			//nothing but delims: no field 0 either
+			if (fieldBegin == lineEnd) index = -1;
+		}
+		fieldEnd = findDelim(fieldBegin);
+	}
+
+	//moves forward to field i.  returns false if the line has no field i.
+	bool seek(int i) {
+		while (index < i) {
+			if (fieldEnd == lineEnd) return false;
+			fieldBegin = fieldEnd + 1;
+			if (mergeDelims) {
+				fieldBegin = skipDelims(fieldBegin);
+				if (fieldBegin == lineEnd) {
+					fieldEnd = lineEnd;
+					return false;
+				}
+			}
+			fieldEnd = findDelim(fieldBegin);
+			++index;
+		}
+		return index == i;
+	}
+
+	std::string_view field() const { return std::string_view(fieldBegin, fieldEnd - fieldBegin); }
+
+	//parses the number at the start of the current field, like sscanf %lf.  false if there isn't one.
+	bool parse(double &x) const {
+		const char *p = fieldBegin;
+		if (p < fieldEnd && *p == '+') ++p;	//from_chars won't take it, sscanf did
+		return std::from_chars(p, fieldEnd, x).ec == std::errc();
+	}
+
+	bool get(int i, double &x) { return seek(i) && parse(x); }
+
+protected:
+	const char *skipDelims(const char *p) const {
+		while (p < lineEnd && *p == delim) ++p;
+		return p;
+	}
+
+	const char *findDelim(const char *p) const {
+		const char *d = (const char*)std::memchr(p, delim, lineEnd - p);
+		return d ? d : lineEnd;
+	}
+};
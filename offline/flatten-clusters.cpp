@@ -33,67 +33,292 @@ for 50k we can associate pointers with points ... but what about with 500m?
 */
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <map>
+#include <functional>
 
 #include "octree.h"
 #include "defs.h"
 #include "util.h"
 #include "exception.h"
-#include "stat.h"
+#include "batch.h"
+#include "clusters.h"
 
-struct Cluster {
-	std::vector<vec3f*> vtxs;
+/*
+the squash is two parallel passes over the catalog.
+the centers and extents come from the catalog summaries mark-clusters wrote, so the points are only read to be moved.
+each cluster with more than one member is cut into pieces of at most maxPieceSize members, so one huge cluster is spread over threads.
+threads take runs of consecutive pieces.
+*/
+static constexpr uint32_t maxPieceSize = 1 << 16;
+
+struct Piece {
+	int group;	//index into FlattenBatchProcessor::groups
+	uint32_t begin, end;	//range of catalog members
 };
 
-//used by method #1, from Angel's paper
-double radialThreshold = 1.;	//bRadial * pow(meanDensityOfGalaxies, -1./3.);
-double tangentialThreshold = radialThreshold / 8.;
+//a cluster with more than one member
+struct Group {
+	int cluster;
+	int pieceBegin, pieceEnd;
+	vec3d center, unitC;
+	bool squash;
+	double squashScalar;
+};
 
-//used by the paper Angel cites
-double avgDensityForRadius[5];
-double maxAvgDensityDist = 0;
+enum FlattenPass {
+	FLATTEN_SQUASH,	//move the points
+	FLATTEN_SUMMARIZE,	//refresh the catalog summaries of squashed clusters
+};
 
-Stat angleDifference;
-Stat redshiftDifference;
+struct FlattenBatchProcessor;
 
-bool testMerge(const vec3d &a, const vec3d &b) {
-#if 0
-	//radial distance in Mpc
-	double distA = a.len();	
-	double distB = b.len();
-	//redshift (z) = distance Mpc * Hubble constant km/s/Mpc / speed of light km/s
-	double velA = distA * HUBBLE_CONSTANT / SPEED_OF_LIGHT;
-	double velB = distB * HUBBLE_CONSTANT / SPEED_OF_LIGHT;
-	//redshift (z)
-	vec3d unitA = a * (1. / distA);
-	vec3d unitB = b * (1. / distB);
-	double cosOmega = dot(unitA, unitB);
-	if (cosOmega < 1.) cosOmega = 1.;
-	if (cosOmega > 1.) cosOmega = 1.;
-	double omega = acos(cosOmega);
-	double distRadial = (distA + distB) * sin(omega);
-	double distTangential = fabs(distA + distB);	//why would abs matter? it was in the originally cited paper (ref?) but most all subsequent papers just prune negative values
-	return (distRadial < radialThreshold
-	&& distTangential < tangentialThreshold);
-#endif
-#if 1
-	//http://arxiv.org/pdf/astro-ph/0310725v2.pdf
-	vec3d c = (a + b) * .5;
-	vec3d unitC = vec3d(c).normalize();
-	vec3d ca = a - c;
-	vec3d cb = b - c;
-	vec3d ab = b - a;
-
-	double radialAB = vec3d::dot(ab, unitC); 
-	double transverseAB = (ab - radialAB * unitC).len();
-
-	double avgDist = c.len();
-	int avgDistBin = (int)((double)numberof(avgDensityForRadius) * avgDist / maxAvgDensityDist);
-	double avgDensity = avgDistBin >= numberof(avgDensityForRadius) ? 0 : avgDensityForRadius[avgDistBin];
-	//avgDensity is a function of space ...
-	const double overdensity = 200.;
-	const double rTransverseMax = 5.;	//used for sdss at least
-	return sqrt(radialAB * radialAB / 100. + transverseAB * transverseAB) <= pow(4./3.*M_PI*avgDensity*(1.+overdensity) + 1./(rTransverseMax*rTransverseMax*rTransverseMax), -1./3.);
-#endif
+struct FlattenWorker {
+	typedef std::pair<int, int> ArgType;	//range of pieces
+	FlattenBatchProcessor &batch;
+
+	FlattenWorker(BatchProcessor<FlattenWorker> *batch_);
+
+	std::string desc(const ArgType &range) {
+		return std::string() + "pieces " + std::to_string(range.first) + "-" + std::to_string(range.second);
+	}
+
+	void operator()(const ArgType &range);
+};
+
+struct FlattenBatchProcessor : public BatchProcessor<FlattenWorker> {
+	vec3f *vtxs;
+	ClusterCatalog &catalog;
+	std::vector<Piece> pieces;
+	std::vector<Group> groups;
+	FlattenPass pass;
+
+	FlattenBatchProcessor(vec3f *vtxs_, ClusterCatalog &catalog_)
+	: vtxs(vtxs_), catalog(catalog_) {
+		for (int c = 0; c < catalog.numClusters(); ++c) {
+			uint32_t begin = (uint32_t)(catalog.begin(c) - catalog.members);
+			uint32_t end = (uint32_t)(catalog.end(c) - catalog.members);
+			if (end - begin < 2) continue;
+			Group group = {};
+			group.cluster = c;
+			group.pieceBegin = (int)pieces.size();
+			for (uint32_t m = begin; m < end; m += maxPieceSize) {
+				Piece piece = {};
+				piece.group = (int)groups.size();
+				piece.begin = m;
+				piece.end = std::min(end, m + maxPieceSize);
+				pieces.push_back(piece);
+			}
+			group.pieceEnd = (int)pieces.size();
+			groups.push_back(group);
+		}
+	}
+
+	void run(FlattenPass pass_) {
+		pass = pass_;
+		//a few runs per thread, so one slow run doesn't leave the rest idle
+		size_t numMembers = 0;
+		for (const Piece &piece : pieces) numMembers += piece.end - piece.begin;
+		size_t runSize = std::max<size_t>(maxPieceSize, numMembers / (4 * std::max<size_t>(1, threads.size())));
+		for (int i = 0; i < (int)pieces.size();) {
+			int j = i;
+			for (size_t size = 0; j < (int)pieces.size() && size < runSize; ++j) {
+				size += pieces[j].end - pieces[j].begin;
+			}
+			addThreadArg(std::make_pair(i, j));
+			i = j;
+		}
+		(*this)();
+	}
+};
+
+FlattenWorker::FlattenWorker(BatchProcessor<FlattenWorker> *batch_)
+: batch(*(FlattenBatchProcessor*)batch_)
+{}
+
+void FlattenWorker::operator()(const ArgType &range) {
+	vec3f *vtxs = batch.vtxs;
+	for (int p = range.first; p < range.second; ++p) {
+		Piece &piece = batch.pieces[p];
+		Group &group = batch.groups[piece.group];
+		const uint32_t *begin = batch.catalog.members + piece.begin;
+		const uint32_t *end = batch.catalog.members + piece.end;
+		switch (batch.pass) {
+		case FLATTEN_SQUASH:
+			if (!group.squash) break;
+			for (const uint32_t *m = begin; m < end; ++m) {
+				vec3f &v = vtxs[*m];
+				vec3d d = (vec3d)v - group.center;
+				double radial = vec3d::dot(d, group.unitC);
+				vec3d transverse = d - radial * group.unitC;
+				//re-stretch radial component
+				radial *= group.squashScalar;
+				//re-apply it to the difference-to-center
+				d = transverse + group.unitC * radial;
+				//re-apply it to the start std::vector
+				v = group.center + d;
+			}
+			break;
+		case FLATTEN_SUMMARIZE:
+			//whole cluster at once, from its first piece
+			if (!group.squash || p != group.pieceBegin) break;
+			summarizeCluster(batch.catalog.summary(group.cluster), vtxs, batch.catalog.begin(group.cluster), batch.catalog.end(group.cluster));
+			break;
+		}
+	}
+}
+
+/*
+--octree: the same squash, streamed over an octree dataset and the octree/node*.clusters labels mark-clusters --octree writes.
+only per-cluster state and one leaf at a time are held.
+pass 1 sums each cluster's points.
+pass 2 finds each cluster's farthest radial and transverse distance from its center, which needs pass 1's center.
+pass 3 squashes the points and rewrites the leaves.
+a squashed point can leave its leaf's box.  it's moved, label and all, to the leaf that holds it, so the octree stays valid.
+(a point with no leaf to go to stays where it is.)
+moved points go at the end of their new leaf, so labels are no longer strictly in order of first vertex.
+*/
+struct ClusterState {
+	vec3d center;	//the sum, until pass 1 is done
+	uint32_t size;
+	double radialMax, transverseMax;
+	bool squash;
+};
+
+struct LeafMovers {
+	std::vector<vec3f> vtxs;
+	std::vector<int> labels;
+};
+
+static void flattenOctree(std::string const & datasetname, bool dontWrite) {
+	std::string dir = std::string() + "datasets/" + datasetname + "/";
+	std::unique_ptr<OctreeNode> root(OctreeNode::readSet(datasetname));
+
+	std::vector<OctreeNode*> leaves;
+	std::function<void(OctreeNode*)> collect = [&](OctreeNode *node) {
+		if (node->leaf) {
+			if (node->numPoints) leaves.push_back(node);
+			return;
+		}
+		for (int i = 0; i < numberof(node->ch); ++i) {
+			if (node->ch[i]) collect(node->ch[i]);
+		}
+	};
+	collect(root.get());
+	std::cout << leaves.size() << " leaves" << std::endl;
+
+	//calls f(point, label) for each point of each leaf
+	auto forEachPoint = [&](std::function<void(const vec3f &, int)> f) {
+		for (OctreeNode *leaf : leaves) {
+			MappedFile pointFile(dir + leaf->getFileName());
+			MappedFile labelFile(dir + leaf->getFileNameBase() + ".clusters");
+			size_t n = pointFile.size() / sizeof(vec3f);
+			if (labelFile.size() != n * sizeof(int)) throw Exception() << leaf->getFileNameBase() << ".clusters doesn't match its point count";
+			const vec3f *vtxs = (const vec3f*)pointFile.data();
+			const int *labels = (const int*)labelFile.data();
+			for (size_t i = 0; i < n; ++i) {
+				f(vtxs[i], labels[i]);
+			}
+		}
+	};
+
+	std::vector<ClusterState> clusters;
+	profile("centers", [&](){
+		forEachPoint([&](const vec3f &v, int label) {
+			if (label < 0) throw Exception() << "negative cluster label " << label;
+			if (label >= (int)clusters.size()) clusters.resize(label + 1, ClusterState());
+			ClusterState &c = clusters[label];
+			c.center += (vec3d)v;
+			c.size++;
+		});
+		for (ClusterState &c : clusters) {
+			if (c.size) c.center *= 1. / (double)c.size;
+		}
+	});
+
+	int singleClusters = 0;
+	for (const ClusterState &c : clusters) {
+		if (c.size == 1) singleClusters++;
+	}
+	std::cout << clusters.size() << " clusters, " << singleClusters << " individual clusters" << std::endl;
+
+	profile("extents", [&](){
+		forEachPoint([&](const vec3f &v, int label) {
+			ClusterState &c = clusters[label];
+			if (c.size < 2) return;
+			vec3d unitC = vec3d(c.center).normalize();
+			vec3d d = (vec3d)v - c.center;
+			double radial = vec3d::dot(d, unitC);
+			double transverse = (d - radial * unitC).len();
+			c.radialMax = std::max(c.radialMax, fabs(radial));
+			c.transverseMax = std::max(c.transverseMax, transverse);
+		});
+	});
+
+	int squashCount = 0;
+	for (ClusterState &c : clusters) {
+		c.squash = c.size > 1 && c.radialMax > c.transverseMax;
+		if (c.squash) squashCount++;
+	}
+	std::cout << "squashed " << squashCount << " clusters" << std::endl;
+	if (dontWrite) return;
+
+	std::map<OctreeNode*, LeafMovers> movers;
+	size_t numMoved = 0;
+	profile("squashing", [&](){
+		for (OctreeNode *leaf : leaves) {
+			std::string pointFilename = dir + leaf->getFileName();
+			std::string labelFilename = dir + leaf->getFileNameBase() + ".clusters";
+			std::vector<bool> leaving;
+			std::vector<vec3f> keptVtxs;
+			std::vector<int> keptLabels;
+			{
+				MappedFile pointFile(pointFilename, MappedFile::MAP_WRITE);
+				MappedFile labelFile(labelFilename);
+				size_t n = pointFile.size() / sizeof(vec3f);
+				vec3f *vtxs = (vec3f*)pointFile.data();
+				const int *labels = (const int*)labelFile.data();
+				for (size_t i = 0; i < n; ++i) {
+					const ClusterState &c = clusters[labels[i]];
+					if (!c.squash) continue;
+					vec3d unitC = vec3d(c.center).normalize();
+					vec3f &v = vtxs[i];
+					vec3d d = (vec3d)v - c.center;
+					double radial = vec3d::dot(d, unitC);
+					vec3d transverse = d - radial * unitC;
+					radial *= c.transverseMax / c.radialMax;
+					d = transverse + unitC * radial;
+					v = c.center + d;
+
+					if (OctreeNode::contains(leaf->bbox, v)) continue;
+					OctreeNode *dest = root->findLeaf(v);
+					if (!dest || dest == leaf) continue;
+					LeafMovers &m = movers[dest];
+					m.vtxs.push_back(v);
+					m.labels.push_back(labels[i]);
+					if (leaving.empty()) leaving.resize(n);
+					leaving[i] = true;
+					numMoved++;
+				}
+				if (leaving.empty()) continue;
+				for (size_t i = 0; i < n; ++i) {
+					if (leaving[i]) continue;
+					keptVtxs.push_back(vtxs[i]);
+					keptLabels.push_back(labels[i]);
+				}
+			}
+			//rewrite without the points that left, now that the maps are closed
+			writeFile(pointFilename, keptVtxs.data(), keptVtxs.size() * sizeof(vec3f));
+			writeFile(labelFilename, keptLabels.data(), keptLabels.size() * sizeof(int));
+		}
+
+		//squashed already, so they're appended after their new leaf's own pass
+		for (std::pair<OctreeNode* const, LeafMovers> &p : movers) {
+			appendFile(dir + p.first->getFileName(), p.second.vtxs.data(), p.second.vtxs.size() * sizeof(vec3f));
+			appendFile(dir + p.first->getFileNameBase() + ".clusters", p.second.labels.data(), p.second.labels.size() * sizeof(int));
+		}
+	});
+	std::cout << "moved " << numMoved << " points to other leaves" << std::endl;
 }
 
 void _main(std::vector<std::string> const & args) {
@@ -101,17 +326,21 @@ void _main(std::vector<std::string> const & args) {
 	std::string datasetname = "allsky";
 
 	bool dontWrite = false;
-	bool outputRadialDistribution = false;
+	int numThreads = 0;
+	bool octree = false;
 	HandleArgs(args, {
 		{"--set", {"<set> = specify the dataset. default is 'allsky'.", {[&](std::string s){
 			datasetname = s;
 		}}}},
-		{"--radial-distribution", {"= output data for the density distribution bins.", {[&](){
-			outputRadialDistribution = true;
-		}}}},
 		{"--dont-write", {"= don't write points back out, just print # clusters.", {[&](){
 			dontWrite = true;
 		}}}},
+		{"--threads", {"<n> = number of threads.  default is the hardware concurrency.", {std::function<void(int)>([&](int n){
+			numThreads = n;
+		})}}},
+		{"--octree", {"= flatten the octree leaves out-of-core, using the octree/node*.clusters from mark-clusters --octree.", {[&](){
+			octree = true;
+		}}}},
 #if 0
 		{"--file", {"<file>	convert only this file. omit path and ext.", {[&](std::string s){
 			gotFile = true;
@@ -123,6 +352,11 @@ void _main(std::vector<std::string> const & args) {
 #endif
 	});
 
+	if (octree) {
+		flattenOctree(datasetname, dontWrite);
+		return;
+	}
+
 #if 1	//single file / buffer all points at once
 	//util.cpp me plz
 	std::list<std::string> filenames;
@@ -140,174 +374,56 @@ void _main(std::vector<std::string> const & args) {
 
 	assert(filenames.size() == 1);
 
-	std::streamsize numVtxs;
+	//points are moved in place.  --dont-write maps them copy-on-write, so the file is left alone
 	std::string filename = std::string() + "datasets/" + datasetname + "/points/" + *filenames.begin();
-	vec3f *vtxs = (vec3f*)getFile(filename, &numVtxs);
-	numVtxs /= sizeof(vec3f);
-
-	int *vtxClusters = nullptr;
-	{
-		std::string base, ext;
-		getFileNameParts(*filenames.begin(), base, ext);
-		std::streamsize vtxClusterFileSize;
-		vtxClusters = (int*)getFile(std::string("datasets/") + datasetname + "/points/" + base + ".clusters", &vtxClusterFileSize);
-		assert(vtxClusterFileSize == numVtxs * sizeof(int));
-	}
+	MappedFile pointFile(filename, dontWrite ? MappedFile::MAP_COPY_ON_WRITE : MappedFile::MAP_WRITE);
+	vec3f *vtxs = (vec3f*)pointFile.data();
+	int numVtxs = (int)(pointFile.size() / sizeof(vec3f));
 
-	//determine clustering thresholds
-	maxAvgDensityDist = 0.;	
-	for (vec3f *v = vtxs; v < vtxs + numVtxs; v++) {
-		double d = v->len();
-		if (d > maxAvgDensityDist) maxAvgDensityDist = d;
-	}
-	//increase by half-step
-	maxAvgDensityDist *= (double)(numberof(avgDensityForRadius)+.5) / (double)numberof(avgDensityForRadius);
-
-	for (vec3f *v = vtxs; v < vtxs + numVtxs; v++) {
-		double d = v->len();
-		int bin = (int)(numberof(avgDensityForRadius) * d / maxAvgDensityDist);
-		avgDensityForRadius[bin]++;
-	}
-
-	for (int i = 0; i < numberof(avgDensityForRadius); i++) {
-		double innerRadius = (double)i / (double)numberof(avgDensityForRadius);
-		double outerRadius = innerRadius + 1. / (double)numberof(avgDensityForRadius);
-		double innerVolume = 4./3. * M_PI * innerRadius * innerRadius * innerRadius;
-		double outerVolume = 4./3. * M_PI * outerRadius * outerRadius * outerRadius;
-		double totalVolume = outerVolume - innerVolume;
-		avgDensityForRadius[i] /= totalVolume;
-	}
-
-	if (outputRadialDistribution) {
-		std::ofstream f((std::string("datasets/") + datasetname + "/radial-distribution.txt").c_str(), std::ios::out);
-		for (int i = 0; i < numberof(avgDensityForRadius); i++) {
-			double midr = (((double)i + .5) / (double)numberof(avgDensityForRadius) * maxAvgDensityDist);
-			f << midr << "\t" << avgDensityForRadius[i] << std::endl;
-		}
-		return;
-	}
+	std::string base, ext;
+	getFileNameParts(*filenames.begin(), base, ext);
+	std::string catalogFilename = std::string("datasets/") + datasetname + "/points/" + base + ".csr";
+	std::unique_ptr<ClusterCatalog> catalog(new ClusterCatalog(catalogFilename, !dontWrite));
+	if (catalog->numMembers() != numVtxs) throw Exception() << catalogFilename << " doesn't match the point count";
 
-	std::map<int, int> clusterSizes;
-	for (int i = 0; i < numVtxs; i++) {
-		int clusterIndex = vtxClusters[i];	//find the cluster index of the i'th point
-		clusterSizes[clusterIndex]++;
-	}
 	int singleClusters = 0;
-	for (std::map<int,int>::iterator i = clusterSizes.begin(); i != clusterSizes.end(); ++i) {
-		if (i->second == 1) {
+	for (int c = 0; c < catalog->numClusters(); c++) {
+		int size = catalog->summary(c).size;
+		if (size == 1) {
 			singleClusters++;
 		} else {
-			std::cout << " cluster " << i->first << " has " << i->second << std::endl;
+			std::cout << " cluster " << c << " has " << size << std::endl;
 		}
 	}
 	std::cout << singleClusters << " individual clusters" << std::endl;
 
-	std::vector<Cluster*> clusters;
-	for (int i = 0; i < numVtxs; i++) {
-		int clusterIndex = vtxClusters[i];	//find the cluster index of the i'th point
-		clusterSizes[clusterIndex]++;
-		if (clusters.size() <= clusterIndex) {
-			int oldsize = clusters.size();
-			clusters.resize(clusterIndex+1);	//make sure we have room for it in our std::list of clusters 
-			for (int j = oldsize; j < clusters.size(); j++) {
-				clusters[j] = new Cluster();	//maybe i should use std::vector<Clsuter> clusters ?
-			}
-		}
-		Cluster *ci = clusters[clusterIndex];
-		assert(ci);
-		ci->vtxs.push_back(vtxs+i);	//add this vertex to that cluster index
-	}
-	
-	//now that we made them, find the radial and transverse "dispersions"
+	//now find the radial and transverse "dispersions"
 	// ... this could be stddev or it could be min/max ...
 	//then, if the radial exceeds the transverse, deem it a "Finger of God" and recompress it radially to make it round
+	//the catalog summaries already have each cluster's centroid and radial and transverse maxes, for the points as they are now
+	FlattenBatchProcessor batch(vtxs, *catalog);
+	if (numThreads > 0) batch.setNumThreads(numThreads);
+
 	int squashCount = 0;
-	int clusterIndex = 0;
-	for (std::vector<Cluster*>::iterator ic = clusters.begin(); ic != clusters.end(); ++ic, ++clusterIndex) {
-		Cluster *c = *ic; 
-		if (c->vtxs.size() == 1) continue;
-		std::cout << "cluster " << clusterIndex << " size " << c->vtxs.size() << std::endl;
-		vec3d center;
-		for (std::vector<vec3f*>::iterator iv = c->vtxs.begin(); iv != c->vtxs.end(); ++iv) {
-			const vec3f &v = **iv;
-			//std::cout << "\tpt" << v << std::endl;
-			center += (vec3d)v;
-		}
-		center *= 1. / (double)c->vtxs.size();
-		vec3d unitC = vec3d(center).normalize();
-		Stat absRadialStat, transverseStat;
-		double n = 0;
-		for (std::vector<vec3f*>::iterator iv = c->vtxs.begin(); iv != c->vtxs.end(); ++iv) {
-			const vec3f &v = **iv; 
-			vec3d d = (vec3d)v - center;
-			double radial = vec3d::dot(d, unitC);
-			double transverse = (d - radial * unitC).len();
-			double absRadial = fabs(radial);
-			n++;
-			absRadialStat.accum(absRadial, n);
-			transverseStat.accum(transverse, n);
-		}
-		absRadialStat.calcStdDev();
-		transverseStat.calcStdDev();
-		//std::cout << absRadialStat.rw("absRadial") << transverseStat.rw("transverse") << std::endl;
-		if (absRadialStat.max > transverseStat.max) {
+	for (Group &group : batch.groups) {
+		const ClusterSummary &summary = catalog->summary(group.cluster);
+		group.center = vec3d(summary.centroid[0], summary.centroid[1], summary.centroid[2]);
+		group.unitC = vec3d(group.center).normalize();
+		double radialMax = summary.radialMax, transverseMax = summary.transverseMax;
+		group.squash = radialMax > transverseMax;
+		if (group.squash) {
 			squashCount++;
-			double radialSquashScalar = transverseStat.max / absRadialStat.max;
-			for (std::vector<vec3f*>::iterator iv = c->vtxs.begin(); iv != c->vtxs.end(); ++iv) {
-				vec3f &v = **iv; 
-				vec3d d = (vec3d)v - center;
-				double radial = vec3d::dot(d, unitC);
-				vec3d transverse = d - radial * unitC;
-				//re-stretch radial component
-				radial *= radialSquashScalar;
-				//re-apply it to the difference-to-center
-				d = transverse + unitC * radial;
-				//re-apply it to the start std::vector
-				v = center + d;
-			}
+			group.squashScalar = transverseMax / radialMax;
 		}
 	}
+
+	batch.run(FLATTEN_SQUASH);
 	std::cout << "squashed " << squashCount << " clusters" << std::endl;
-	
-	//now we write back out!
+
+	//the points went back to the file as they moved.  refresh the catalog summaries for the new positions
 	if (!dontWrite) {
-		assert(filenames.size() == 1);
-		std::string filename = std::string() + "datasets/" + datasetname + "/points/" + *filenames.begin();
-		writeFile(filename, vtxs, sizeof(vec3f) * numVtxs);
+		batch.run(FLATTEN_SUMMARIZE);
 	}
-
-	clusters.clear();	
-	delete[] (unsigned char *)vtxs;
-#endif
-
-#if 0	//TODO octree, unless you can fit all 500m points (and clusters) in memory
-	OctreeNode *root = OctreeNode::readSet(datasetname);
-
-	struct CompareIterator {
-		vec3f v;
-		CompareIterator(const vec3f &v_) : v(v_) {}
-		void operator()(OctreeNoe *n) {
-			vec3f *vtxs = getFile(n->getFileName());
-			vec3f *vtxEnd = vtxs + numPoints;
-			for (vec3f *w = vtxs; w < vtxEnd; w++) {
-				testMerge(*v, *w);
-			}
-			delete[] vtxs;
-		}
-	};
-
-	struct NodeIterator {
-		void operator()(OctreeNode *n) {
-			vec3f *vtxs = getFile(n->getFileName());
-			vec3f *vtxEnd = vtxs + numPoints;
-			for (vec3f *v = vtxs; v < vtxEnd; v++) {
-				n->recurse<CompareIterator>(CompareIterator(*v));
-			}
-			delete[] vtxs;
-		}
-	};
-
-	root->recurse<NodeIterator>(NodeIterator());
 #endif
 }
 
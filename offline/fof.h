@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <cstdint>
+#include "vec.h"
+#include "exception.h"
+#include "batch.h"
+
+/*
+friends-of-friends helpers.
+the merge tests in mark-clusters are all bounded by some euclidean distance (their linkingLength()),
+so points get binned into cubic cells of that size and only neighbouring cells are compared.
+clusters are the transitive closure of the merge test, same as the brute force n^2 search.
+*/
+
+//disjoint sets with path compression.  the root of each set is its smallest index.
+struct UnionFind {
+	std::vector<int> parent;
+
+	UnionFind(int n = 0) : parent(n) {
+		for (int i = 0; i < n; ++i) parent[i] = i;
+	}
+
+	int find(int i) {
+		int root = i;
+		while (parent[root] != root) root = parent[root];
+		while (parent[i] != root) {
+			int next = parent[i];
+			parent[i] = root;
+			i = next;
+		}
+		return root;
+	}
+
+	//returns true if a and b were in different sets
+	bool merge(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b) return false;
+		if (a < b) parent[b] = a; else parent[a] = b;
+		return true;
+	}
+
+	//compact labels, numbered in order of each set's smallest index.  returns the # of sets.
+	int labels(int *dest) {
+		int numSets = 0;
+		for (int i = 0; i < (int)parent.size(); ++i) {
+			int root = find(i);
+			dest[i] = root == i ? numSets++ : dest[root];
+		}
+		return numSets;
+	}
+};
+
+//union-find over ids that are mostly never merged.  ids not in the map are their own root.
+struct SparseUnionFind {
+	std::unordered_map<int, int> parent;
+
+	int find(int i) {
+		int root = i;
+		for (;;) {
+			std::unordered_map<int, int>::iterator j = parent.find(root);
+			if (j == parent.end() || j->second == root) break;
+			root = j->second;
+		}
+		while (i != root) {
+			int &p = parent[i];
+			int next = p;
+			p = root;
+			i = next;
+		}
+		return root;
+	}
+
+	bool merge(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b) return false;
+		if (a < b) {
+			parent[b] = a;
+			parent.emplace(a, a);
+		} else {
+			parent[a] = b;
+			parent.emplace(b, b);
+		}
+		return true;
+	}
+};
+
+//points grouped by the cell they fall in, cells sorted by key
+struct SortedCells {
+	struct Cell {
+		uint64_t key;
+		int begin, end;	//range in 'order'
+	};
+
+	std::vector<int> order;	//point indexes, grouped by cell
+	std::vector<Cell> cells;	//sorted by key
+	std::unordered_map<uint64_t, int> cellForKey;
+
+	//returns the cell index or -1
+	int findKey(uint64_t key) const {
+		std::unordered_map<uint64_t, int>::const_iterator j = cellForKey.find(key);
+		return j == cellForKey.end() ? -1 : j->second;
+	}
+
+	//keys[i] = (cell key, point index)
+	void build(std::vector<std::pair<uint64_t, int>> &keys) {
+		std::sort(keys.begin(), keys.end());
+		order.resize(keys.size());
+		for (int i = 0; i < (int)keys.size(); ++i) {
+			order[i] = keys[i].second;
+			if (!i || keys[i].first != keys[i-1].first) {
+				cells.push_back(Cell{keys[i].first, i, i});
+			}
+			cells.back().end = i + 1;
+		}
+		cellForKey.reserve(cells.size());
+		for (int i = 0; i < (int)cells.size(); ++i) {
+			cellForKey[cells[i].key] = i;
+		}
+	}
+};
+
+/*
+cubic cells the size of the linking length.
+grids used by FoFBatchProcessor provide:
+	block(cell) = which block a cell goes in.  non-decreasing in cell index.
+	forEachForwardNeighbor(cell, f) = f(other cell) for each neighbouring cell with a greater index.
+*/
+struct CellGrid : public SortedCells {
+	static constexpr int blockDepth = 4;	//z layers per block
+
+	double cellSize;
+	vec3d min;
+	vec3i size;
+
+	uint64_t key(const vec3i &i) const {
+		return ((uint64_t)i(2) * (uint64_t)size(1) + (uint64_t)i(1)) * (uint64_t)size(0) + (uint64_t)i(0);
+	}
+
+	vec3i keyPos(uint64_t key) const {
+		return vec3i((int)(key % (uint64_t)size(0)), (int)(key / (uint64_t)size(0) % (uint64_t)size(1)), (int)(key / ((uint64_t)size(0) * (uint64_t)size(1))));
+	}
+
+	vec3i cellPos(const vec3f &v) const {
+		vec3i i;
+		for (int k = 0; k < 3; ++k) {
+			i(k) = std::min<int>(size(k) - 1, std::max<int>(0, (int)floor(((double)v(k) - min(k)) / cellSize)));
+		}
+		return i;
+	}
+
+	//returns the cell index or -1
+	int find(const vec3i &i) const {
+		for (int k = 0; k < 3; ++k) {
+			if (i(k) < 0 || i(k) >= size(k)) return -1;
+		}
+		return findKey(key(i));
+	}
+
+	int block(int cell) const {
+		return keyPos(cells[cell].key)(2) / blockDepth;
+	}
+
+	//the 13 neighbours that come after the cell in key order
+	template<typename F>
+	void forEachForwardNeighbor(int cell, F f) const {
+		static const int forward[13][3] = {
+			{1,0,0},
+			{-1,1,0}, {0,1,0}, {1,1,0},
+			{-1,-1,1}, {0,-1,1}, {1,-1,1},
+			{-1,0,1}, {0,0,1}, {1,0,1},
+			{-1,1,1}, {0,1,1}, {1,1,1},
+		};
+		vec3i pos = keyPos(cells[cell].key);
+		for (int n = 0; n < 13; ++n) {
+			int neighbor = find(pos + vec3i(forward[n][0], forward[n][1], forward[n][2]));
+			if (neighbor != -1) f(neighbor);
+		}
+	}
+
+	//call f(point index) for every point in the 27 cells around v.
+	//v can be outside the grid, it gets clamped to the border cells, which only adds candidates.
+	template<typename F>
+	void forEachNeighbor(const vec3f &v, F f) const {
+		vec3i pos = cellPos(v);
+		for (int dz = -1; dz <= 1; ++dz) {
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					int c = find(pos + vec3i(dx, dy, dz));
+					if (c == -1) continue;
+					for (int i = cells[c].begin; i < cells[c].end; ++i) {
+						f(order[i]);
+					}
+				}
+			}
+		}
+	}
+
+	CellGrid(const vec3f *vtxs, int numVtxs, double cellSize_) : cellSize(cellSize_) {
+		if (!(cellSize > 0)) throw Exception() << "cell size must be positive, got " << cellSize;
+		if (!numVtxs) return;
+		vec3d max = min = vtxs[0];
+		for (const vec3f *v = vtxs; v < vtxs + numVtxs; ++v) {
+			for (int k = 0; k < 3; ++k) {
+				min(k) = std::min<double>(min(k), (*v)(k));
+				max(k) = std::max<double>(max(k), (*v)(k));
+			}
+		}
+		for (int k = 0; k < 3; ++k) {
+			double n = floor((max(k) - min(k)) / cellSize) + 1.;
+			if (n > (double)(1 << 20)) throw Exception() << "linking length " << cellSize << " is too small for this data";
+			size(k) = (int)n;
+		}
+
+		std::vector<std::pair<uint64_t, int>> keys(numVtxs);
+		for (int i = 0; i < numVtxs; ++i) {
+			keys[i] = std::make_pair(key(cellPos(vtxs[i])), i);
+		}
+		build(keys);
+	}
+};
+
+/*
+merge all pairs within neighbouring cells that pass mergeTest.
+cells are grouped into blocks by grid.block(), each a contiguous range of cells and of grid.order.
+each block is linked on its own thread with a union-find over just its points.
+pairs reaching into later blocks are tested there too, and kept as candidates.
+then the blocks and candidates are merged into one union-find, in block order.
+the blocks don't depend on the thread count, so neither do the labels or links.
+
+each neighbouring cell pair is visited once, from the cell with the smaller index, so mergeTest has to be symmetric.
+every candidate pair is tested, 64 at a time by MergeTest::testBatch, even ones already in the same set.
+checking the sets first would break up the batches, and the union-find drops those merges anyway.
+links gets one (a,b) per merge, which makes a spanning forest of the clusters.
+*/
+struct FoFBlock {
+	int cellBegin, cellEnd;	//range in grid.cells
+	int begin, end;	//range in grid.order
+	std::vector<vec2i> links;	//merges within the block, as vertex indexes
+	std::vector<vec2i> crossLinks;	//passing pairs from this block into later ones
+};
+
+template<typename MergeTest, typename Grid> struct FoFBatchProcessor;
+
+template<typename MergeTest, typename Grid>
+struct FoFWorker {
+	typedef int ArgType;	//block index
+	FoFBatchProcessor<MergeTest, Grid> &batch;
+	MergeTest mergeTest;	//each thread gets its own copy, some tests accumulate stats
+
+	FoFWorker(BatchProcessor<FoFWorker> *batch_)
+	: batch(*(FoFBatchProcessor<MergeTest, Grid>*)batch_),
+		mergeTest(batch.mergeTest)
+	{}
+
+	std::string desc(const ArgType &blockIndex) {
+		return std::string() + "block " + std::to_string(blockIndex);
+	}
+
+	void operator()(const ArgType &blockIndex);
+};
+
+template<typename MergeTest, typename Grid = CellGrid>
+struct FoFBatchProcessor : public BatchProcessor<FoFWorker<MergeTest, Grid>> {
+	const vec3f *vtxs;
+	const Grid &grid;
+	const MergeTest &mergeTest;
+	typename MergeTest::SoA soa;	//candidates in grid order, for MergeTest::testBatch
+	std::vector<FoFBlock> blocks;
+
+	FoFBatchProcessor(const vec3f *vtxs_, const Grid &grid_, const MergeTest &mergeTest_)
+	: vtxs(vtxs_), grid(grid_), mergeTest(mergeTest_) {}
+
+	void run(UnionFind &sets, std::vector<vec2i> &links) {
+		soa = mergeTest.prepare(vtxs, grid.order);
+		blocks.clear();
+		for (int i = 0; i < (int)grid.cells.size(); ++i) {
+			if (!i || grid.block(i) != grid.block(i-1)) {
+				blocks.push_back(FoFBlock());
+				blocks.back().cellBegin = i;
+				blocks.back().begin = grid.cells[i].begin;
+			}
+			blocks.back().cellEnd = i + 1;
+			blocks.back().end = grid.cells[i].end;
+		}
+
+		for (int i = 0; i < (int)blocks.size(); ++i) {
+			this->addThreadArg(i);
+		}
+		(*this)();
+
+		for (FoFBlock &block : blocks) {
+			for (const vec2i &l : block.links) {
+				sets.merge(l.x, l.y);
+				links.push_back(l);
+			}
+			block.links = std::vector<vec2i>();
+		}
+		for (FoFBlock &block : blocks) {
+			for (const vec2i &l : block.crossLinks) {
+				if (sets.merge(l.x, l.y)) links.push_back(l);
+			}
+			block.crossLinks = std::vector<vec2i>();
+		}
+		soa = typename MergeTest::SoA();
+	}
+};
+
+template<typename MergeTest, typename Grid>
+void FoFWorker<MergeTest, Grid>::operator()(const ArgType &blockIndex) {
+	const Grid &grid = batch.grid;
+	FoFBlock &block = batch.blocks[blockIndex];
+	UnionFind sets(block.end - block.begin);	//indexed by position in grid.order, minus block.begin
+
+	//calls f(j) for each j in [begin,end) that grid position i links to, testing 64 candidates at a time
+	auto forEachLinked = [&](int i, int begin, int end, auto f) {
+		for (int j0 = begin; j0 < end; j0 += 64) {
+			uint64_t mask = mergeTest.testBatch(batch.soa, i, j0, std::min(64, end - j0));
+			for (int j = j0; mask; ++j, mask >>= 1) {
+				if (mask & 1) f(j);
+			}
+		}
+	};
+
+	//pairs inside the block
+	auto testRange = [&](int i, int begin, int end) {
+		forEachLinked(i, begin, end, [&](int j) {
+			if (!sets.merge(i - block.begin, j - block.begin)) return;
+			block.links.push_back(vec2i(grid.order[i], grid.order[j]));
+		});
+	};
+
+	std::vector<std::pair<int, int>> crossCells;
+	for (int c = block.cellBegin; c < block.cellEnd; ++c) {
+		const SortedCells::Cell &cell = grid.cells[c];
+		for (int i = cell.begin; i < cell.end; ++i) {
+			testRange(i, i + 1, cell.end);
+		}
+
+		grid.forEachForwardNeighbor(c, [&](int neighbor) {
+			if (neighbor >= block.cellEnd) {
+				crossCells.push_back(std::make_pair(c, neighbor));
+				return;
+			}
+			const SortedCells::Cell &other = grid.cells[neighbor];
+			for (int i = cell.begin; i < cell.end; ++i) {
+				testRange(i, other.begin, other.end);
+			}
+		});
+	}
+
+	//pairs into later blocks, once the block's own sets are final.
+	//one passing pair per (local set, outside point) is enough.
+	std::unordered_set<uint64_t> linked;
+	for (const std::pair<int, int> &cc : crossCells) {
+		const SortedCells::Cell &cell = grid.cells[cc.first];
+		const SortedCells::Cell &other = grid.cells[cc.second];
+		for (int i = cell.begin; i < cell.end; ++i) {
+			uint64_t root = (uint64_t)sets.find(i - block.begin);
+			forEachLinked(i, other.begin, other.end, [&](int j) {
+				uint64_t key = (root << 32) | (uint64_t)j;
+				if (!linked.insert(key).second) return;
+				block.crossLinks.push_back(vec2i(grid.order[i], grid.order[j]));
+			});
+		}
+	}
+}
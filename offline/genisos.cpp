@@ -1,73 +1,541 @@
 /*
-what will this do?
-calculate density isobar ...
-rbf or something around each point
-then either marching cubes or (!!) surface nets over the whole thing
+isosurfaces of a density field, using surface nets.
+reads datasets/<set>/density.svol if it is there, otherwise density.vol
+or with --kde, builds the field from the .f32 files in datasets/<set>/points/ with a compact kernel (see PointGrid below)
+writes datasets/<set>/isos.mesh, one indexed triangle mesh per iso level, all levels from the same pass over the field.
+
+samples sit at cell centers, so the surface lives on the (size-1)^3 grid of cubes between them.
+each cube the surface passes through gets one vertex, the average of where its edges cross the iso value.
+each sample edge the surface crosses gets a quad joining the vertexes of the 4 cubes around it.
+
+the cubes are cut into z-slabs which go through the batch processor twice:
+1) find each slab's vertexes.  a prefix sum over the slabs then gives each slab's first vertex index.
+2) emit each slab's quads, looking up vertexes in the slab below when an edge's cubes straddle slabs.
+slabs are a fixed depth and get concatenated in order, so the output doesn't depend on the thread count.
 */
-#include "vec.h"
+#include <cmath>
+#include <cstring>	//std::memcpy
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include "vec.h"
+#include "box.h"
 #include "util.h"
 #include "stat.h"
+#include "batch.h"
+#include "volume.h"
+#include "exception.h"
+
+/*
+layout, little endian:
+	MeshFileHeader
+	MeshLevel [numLevels]
+	then for each level:
+		float [numVertexes][3] -- positions in the [-1,1] cube the web viewer draws the volume in
+		uint32_t [numTriangles][3] -- counter-clockwise seen from the low density side
+*/
+struct MeshFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numLevels;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 1;
+};
+
+const char MeshFileHeader::signature[4] = {'M', 'E', 'S', 'H'};
+
+struct MeshLevel {
+	float iso;
+	uint32_t numVertexes;
+	uint32_t numTriangles;
+};
+
+//dense size^3 field, x fastest
+struct Field {
+	int size;
+	std::vector<float> values;
+
+	Field() : size(0) {}
+
+	float get(int x, int y, int z) const {
+		return values[x + size * ((long)y + size * (long)z)];
+	}
+
+	void read(std::string const & filename);
+};
+
+void Field::read(std::string const & filename) {
+	std::string base, ext;
+	getFileNameParts(filename, base, ext);
+	if (ext == "svol") {
+		SparseVolume volume;
+		volume.read(filename);
+		size = volume.size();
+		values = volume.toDense();
+		return;
+	}
+
+	std::streamsize numBytes = 0;
+	float *data = (float*)getFile(filename, &numBytes);
+	long numValues = numBytes / sizeof(float);
+	size = (int)std::lround(std::cbrt((double)numValues));
+	if ((long)size * size * size != numValues) {
+		delete[] (char*)data;
+		throw Exception() << filename << " has " << numValues << " floats, which isn't a cube";
+	}
+	values.assign(data, data + numValues);
+	delete[] (char*)data;
+}
+
+/*
+points binned into a uniform grid of cells as wide as the kernel radius,
+so a sample only has to look at the 3x3x3 cells around it.
+stored CSR style: the points of cell i are points[cellStart[i]] to points[cellStart[i+1]], in the order they were read.
+*/
+struct PointGrid {
+	vec3f min;
+	float cellSize;
+	int dim[3];
+	std::vector<uint32_t> cellStart;
+	std::vector<vec3f> points;
+
+	void build(std::vector<vec3f> const & src, vec3f const & min_, vec3f const & max_, float cellSize_);
+
+	int cellCoord(float v, int axis) const {
+		return std::clamp((int)floor((v - min[axis]) / cellSize), 0, dim[axis] - 1);
+	}
+
+	long cellIndex(int x, int y, int z) const {
+		return x + dim[0] * ((long)y + dim[1] * (long)z);
+	}
+
+	//quartic (biweight) kernel, (1 - r^2/h^2)^2 inside radius h = cellSize, summed over all points
+	double density(vec3f const & p) const;
+};
+
+void PointGrid::build(std::vector<vec3f> const & src, vec3f const & min_, vec3f const & max_, float cellSize_) {
+	min = min_;
+	cellSize = cellSize_;
+	for (int i = 0; i < 3; i++) {
+		dim[i] = std::max(1, (int)ceil((max_[i] - min_[i]) / cellSize));
+	}
+	long numCells = (long)dim[0] * dim[1] * dim[2];
+
+	//counting sort by cell
+	std::vector<long> cellOf(src.size());
+	cellStart.assign(numCells + 1, 0);
+	for (size_t i = 0; i < src.size(); i++) {
+		cellOf[i] = cellIndex(cellCoord(src[i].x, 0), cellCoord(src[i].y, 1), cellCoord(src[i].z, 2));
+		cellStart[cellOf[i] + 1]++;
+	}
+	for (long i = 0; i < numCells; i++) {
+		cellStart[i + 1] += cellStart[i];
+	}
+	points.resize(src.size());
+	std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+	for (size_t i = 0; i < src.size(); i++) {
+		points[next[cellOf[i]]++] = src[i];
+	}
+}
+
+double PointGrid::density(vec3f const & p) const {
+	double invRadiusSq = 1. / ((double)cellSize * cellSize);
+	int c[3] = {cellCoord(p.x, 0), cellCoord(p.y, 1), cellCoord(p.z, 2)};
+	double sum = 0;
+	for (int z = std::max(0, c[2] - 1); z <= std::min(dim[2] - 1, c[2] + 1); z++) {
+		for (int y = std::max(0, c[1] - 1); y <= std::min(dim[1] - 1, c[1] + 1); y++) {
+			for (int x = std::max(0, c[0] - 1); x <= std::min(dim[0] - 1, c[0] + 1); x++) {
+				long cell = cellIndex(x, y, z);
+				for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+					double dx = points[i].x - p.x;
+					double dy = points[i].y - p.y;
+					double dz = points[i].z - p.z;
+					double t = 1. - (dx * dx + dy * dy + dz * dz) * invRadiusSq;
+					if (t > 0) sum += t * t;
+				}
+			}
+		}
+	}
+	return sum;
+}
+
+struct Slab {
+	int z0, z1;	//cube z range
+	struct Level {
+		std::vector<long> cubes;	//linear index of the cube each vertex is in, ascending
+		std::vector<vec3f> vtxs;
+		std::vector<uint32_t> tris;
+		uint32_t firstVertex;
+	};
+	std::vector<Level> levels;
+};
+
+struct IsoBatchProcessor;
+
+struct SlabWorker {
+	IsoBatchProcessor &batch;
+	typedef int ArgType;	//slab index
+	std::string desc(const ArgType &slabIndex);
+
+	SlabWorker(BatchProcessor<SlabWorker> *batch_);
+
+	void operator()(const ArgType &slabIndex);
+	void evalDensity(Slab &slab);
+	void findVertexes(Slab &slab);
+	void emitQuads(Slab &slab);
+};
+
+struct IsoBatchProcessor : public BatchProcessor<SlabWorker> {
+	static constexpr int slabDepth = 16;
+
+	Field field;
+	std::vector<float> isos;
+	std::vector<Slab> slabs;
+	int pass;
+
+	//for --kde
+	PointGrid pointGrid;
+	vec3f bmin, bmax;
+
+	IsoBatchProcessor() : pass(0) {}
+
+	int numCubes() const { return field.size - 1; }
+
+	long cubeIndex(int x, int y, int z) const {
+		return x + numCubes() * ((long)y + numCubes() * (long)z);
+	}
+
+	//global index of the vertex in cube (x,y,z).  only valid after the first pass.
+	uint32_t vertexIndex(int level, int x, int y, int z) const {
+		Slab::Level const & l = slabs[z / slabDepth].levels[level];
+		long cube = cubeIndex(x, y, z);
+		auto i = std::lower_bound(l.cubes.begin(), l.cubes.end(), cube);
+		assert(i != l.cubes.end() && *i == cube);
+		return l.firstVertex + (uint32_t)(i - l.cubes.begin());
+	}
+
+	void makeSlabs(int n);
+	void buildDensity(std::string const & datasetname, int size, float bandwidth);
+	void run();
+	void write(std::string const & filename) const;
+};
 
-using namespace std;
-	
-const int binRes = 256;
+SlabWorker::SlabWorker(BatchProcessor<SlabWorker> *batch_)
+:	batch(*(IsoBatchProcessor*)batch_)
+{}
 
-int ifloor(float f) {
-	int i = (int)f;
-	if (f < 0) i--;
-	return i;
+std::string SlabWorker::desc(const ArgType &slabIndex) {
+	return std::string() + "pass " + std::to_string(batch.pass) + " slab " + std::to_string(slabIndex);
 }
 
-streamsize vtxCount = 0;
-StatSet totalSet;
-float totalSize[3];
-vec3f *vtxBuf = nullptr;
+void SlabWorker::operator()(const ArgType &slabIndex) {
+	Slab &slab = batch.slabs[slabIndex];
+	if (batch.pass == 0) {
+		evalDensity(slab);
+	} else if (batch.pass == 1) {
+		findVertexes(slab);
+	} else {
+		emitQuads(slab);
+	}
+}
 
-//TODO this looks like a job for the octree
-float getValue(float *fpos) {
-	vec3f *vtxEnd = vtxBuf + vtxCount;
-	for (vec3f *v = vtxBuf; v < vtxEnd; v++) {
-		
+//samples z0 to z1 of the kernel density field.  z0 and z1 are samples here, not cubes.
+void SlabWorker::evalDensity(Slab &slab) {
+	Field &field = batch.field;
+	vec3f p;
+	for (int z = slab.z0; z < slab.z1; z++) {
+		p.z = batch.bmin.z + (batch.bmax.z - batch.bmin.z) * ((float)z + .5f) / (float)field.size;
+		for (int y = 0; y < field.size; y++) {
+			p.y = batch.bmin.y + (batch.bmax.y - batch.bmin.y) * ((float)y + .5f) / (float)field.size;
+			for (int x = 0; x < field.size; x++) {
+				p.x = batch.bmin.x + (batch.bmax.x - batch.bmin.x) * ((float)x + .5f) / (float)field.size;
+				field.values[x + field.size * ((long)y + field.size * (long)z)] = (float)batch.pointGrid.density(p);
+			}
+		}
 	}
 }
 
-void getCornerValues(const int *ipos, float *cornerValues) {
-	int cipos[3];
-	float cfpos[3];
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 3; j++) {
-			cipos[j] = ipos[j] + ((i>>j)&1);
-			cfpos[j] = (float)cipos[j] / (float)binRes * totalSize[j] + totalSet.vars()[STATSET_X+j].min;
+void SlabWorker::findVertexes(Slab &slab) {
+	//corner i is at +x if bit 0 is set, +y if bit 1, +z if bit 2
+	static const int edges[12][2] = {
+		{0,1}, {2,3}, {4,5}, {6,7},
+		{0,2}, {1,3}, {4,6}, {5,7},
+		{0,4}, {1,5}, {2,6}, {3,7},
+	};
+
+	Field const & field = batch.field;
+	int n = batch.numCubes();
+	float invSize = 1.f / (float)field.size;
+	float c[8];
+	for (int z = slab.z0; z < slab.z1; z++) {
+		for (int y = 0; y < n; y++) {
+			for (int x = 0; x < n; x++) {
+				float cmin = INFINITY, cmax = -INFINITY;
+				for (int i = 0; i < 8; i++) {
+					c[i] = field.get(x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2));
+					cmin = std::min(cmin, c[i]);
+					cmax = std::max(cmax, c[i]);
+				}
+				for (int l = 0; l < (int)batch.isos.size(); l++) {
+					float iso = batch.isos[l];
+					if (cmin >= iso || cmax < iso) continue;
+
+					vec3f sum;
+					int numCrossings = 0;
+					for (auto const & e : edges) {
+						float a = c[e[0]], b = c[e[1]];
+						if ((a >= iso) == (b >= iso)) continue;
+						float t = (iso - a) / (b - a);
+						for (int k = 0; k < 3; k++) {
+							float pa = (float)((e[0] >> k) & 1);
+							float pb = (float)((e[1] >> k) & 1);
+							sum[k] += pa + t * (pb - pa);
+						}
+						numCrossings++;
+					}
+
+					//sample s sits at the center of cell s, which is -1 + 2 (s + .5) / size in the viewer's cube
+					vec3f v;
+					v.x = -1.f + 2.f * ((float)x + sum.x / (float)numCrossings + .5f) * invSize;
+					v.y = -1.f + 2.f * ((float)y + sum.y / (float)numCrossings + .5f) * invSize;
+					v.z = -1.f + 2.f * ((float)z + sum.z / (float)numCrossings + .5f) * invSize;
+					slab.levels[l].cubes.push_back(batch.cubeIndex(x, y, z));
+					slab.levels[l].vtxs.push_back(v);
+				}
+			}
 		}
-		cornerValues[i] = getValue(cfpos);
 	}
 }
 
-int main() {
-	vtxBuf = (vec3f*)getFile("datasets/2mrs/points/points.f32", &vtxCount);
-	vtxCount /= sizeof(vec3f);
-	vec3f *vtxEnd = vtxBuf + vtxCount;
+void SlabWorker::emitQuads(Slab &slab) {
+	Field const & field = batch.field;
+	int n = batch.numCubes();
+	for (int l = 0; l < (int)batch.isos.size(); l++) {
+		float iso = batch.isos[l];
+		std::vector<uint32_t> &tris = slab.levels[l].tris;
+		//edge from sample p to p + 1 along 'axis'.  u and v are the other two axii, in right-handed order.
+		for (int axis = 0; axis < 3; axis++) {
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			int p[3];
+			int zmin = axis == 2 ? slab.z0 : std::max(slab.z0, 1);
+			for (p[2] = zmin; p[2] < slab.z1; p[2]++) {
+				for (p[1] = axis == 1 ? 0 : 1; p[1] < n; p[1]++) {
+					for (p[0] = axis == 0 ? 0 : 1; p[0] < n; p[0]++) {
+						int q[3] = {p[0], p[1], p[2]};
+						q[axis]++;
+						bool a = field.get(p[0], p[1], p[2]) >= iso;
+						bool b = field.get(q[0], q[1], q[2]) >= iso;
+						if (a == b) continue;
 
-	totalSet.read("datasets/2mrs/stats/total.stats");
+						//the 4 cubes around the edge, counter-clockwise looking down +axis
+						uint32_t quad[4];
+						static const int ring[4][2] = {{-1,-1}, {0,-1}, {0,0}, {-1,0}};
+						for (int k = 0; k < 4; k++) {
+							int cube[3] = {p[0], p[1], p[2]};
+							cube[u] += ring[k][0];
+							cube[v] += ring[k][1];
+							quad[k] = batch.vertexIndex(l, cube[0], cube[1], cube[2]);
+						}
+						//face away from the dense side
+						if (a) {
+							tris.insert(tris.end(), {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]});
+						} else {
+							tris.insert(tris.end(), {quad[0], quad[2], quad[1], quad[0], quad[3], quad[2]});
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void IsoBatchProcessor::makeSlabs(int n) {
+	int numSlabs = (n + slabDepth - 1) / slabDepth;
+	slabs.clear();
+	slabs.resize(numSlabs);
+	for (int i = 0; i < numSlabs; i++) {
+		slabs[i].z0 = i * slabDepth;
+		slabs[i].z1 = std::min(n, (i + 1) * slabDepth);
+		slabs[i].levels.resize(isos.size());
+	}
+}
+
+/*
+kernel density of the dataset's points sampled at the cell centers of a size^3 grid,
+over the same padded cube around total.stats that genvolume uses.
+bandwidth is the kernel radius in world units, 0 for two cells.
+normalized so the densest sample is 1, same as density.vol
+*/
+void IsoBatchProcessor::buildDensity(std::string const & datasetname, int size, float bandwidth) {
+	StatSet totalStats;
+	totalStats.read((std::string() + "datasets/" + datasetname + "/stats/total.stats").c_str());
+	float halfWidth = 0;
+	vec3f center;
 	for (int i = 0; i < 3; i++) {
-		totalSize[i] = totalSet.vars()[STATSET_X+i].max - totalSet.vars()[STATSET_X+i].min;
-	}
-
-	int ipos[3];	//integer position in discretized space
-	//start at each point (?)
-	//march one way til you find the surface
-	//then start crawling
-	for (vec3f *v = vtxBuf; v < vtxEnd; v++) {
-		float fpos[3];
-		for (int i = 0; i < 3; i++) {
-			fpos[i] = ((*v)[i] - totalSet.vars()[STATSET_X+i].min) / totalSize[i];
-			//if (fx < 0 || fx >= 1 || fy < 0 || fy >= 1 || fz < 0 || fz >= 1) continue;
-			fpos[i] *= (float)binRes;
-			ipos[i] = ifloor(fpos[i]);
+		center[i] = .5f * (totalStats.vars()[STATSET_X+i].max + totalStats.vars()[STATSET_X+i].min);
+		halfWidth = std::max(halfWidth, .5f * (float)(totalStats.vars()[STATSET_X+i].max - totalStats.vars()[STATSET_X+i].min));
+	}
+	halfWidth *= (float)(size+1) / (float)size;
+	for (int i = 0; i < 3; i++) {
+		bmin[i] = center[i] - halfWidth;
+		bmax[i] = center[i] + halfWidth;
+	}
+	if (bandwidth <= 0) bandwidth = 4.f * halfWidth / (float)size;
+
+	//only points that can reach a sample matter
+	std::vector<vec3f> points;
+	box3f reach(bmin - vec3f(bandwidth), bmax + vec3f(bandwidth));
+	for (auto const & filename : getDirFileNames(std::string() + "datasets/" + datasetname + "/points")) {
+		std::string base, ext;
+		getFileNameParts(filename, base, ext);
+		if (ext != "f32") continue;
+		std::streamsize numBytes = 0;
+		vec3f *vtxs = (vec3f*)getFile(std::string() + "datasets/" + datasetname + "/points/" + filename, &numBytes);
+		vec3f *vtxsEnd = vtxs + numBytes / sizeof(vec3f);
+		for (vec3f *v = vtxs; v < vtxsEnd; v++) {
+			if (v->x >= reach.min.x && v->y >= reach.min.y && v->z >= reach.min.z
+				&& v->x <= reach.max.x && v->y <= reach.max.y && v->z <= reach.max.z)
+			{
+				points.push_back(*v);
+			}
+		}
+		delete[] (char*)vtxs;
+	}
+	std::cout << points.size() << " points, kernel radius " << bandwidth << std::endl;
+	pointGrid.build(points, reach.min, reach.max, bandwidth);
+
+	field.size = size;
+	field.values.assign((long)size * size * size, 0.f);
+	makeSlabs(size);
+	pass = 0;
+	for (int i = 0; i < (int)slabs.size(); i++) addThreadArg(i);
+	(*this)();
+
+	float maxDensity = *std::max_element(field.values.begin(), field.values.end());
+	if (maxDensity > 0) {
+		for (float &v : field.values) v /= maxDensity;
+	}
+}
+
+void IsoBatchProcessor::run() {
+	if (field.size < 2) throw Exception() << "field is too small";
+	int n = numCubes();
+	makeSlabs(n);
+	int numSlabs = slabs.size();
+
+	pass = 1;
+	for (int i = 0; i < numSlabs; i++) addThreadArg(i);
+	(*this)();
+
+	for (int l = 0; l < (int)isos.size(); l++) {
+		uint32_t numVertexes = 0;
+		for (auto & slab : slabs) {
+			slab.levels[l].firstVertex = numVertexes;
+			numVertexes += slab.levels[l].vtxs.size();
+		}
+	}
+
+	pass = 2;
+	for (int i = 0; i < numSlabs; i++) addThreadArg(i);
+	(*this)();
+}
+
+void IsoBatchProcessor::write(std::string const & filename) const {
+	std::ofstream f(filename, std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << filename << " for writing";
+
+	MeshFileHeader header = {};
+	std::memcpy(header.magic, MeshFileHeader::signature, sizeof(header.magic));
+	header.version = MeshFileHeader::currentVersion;
+	header.numLevels = isos.size();
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (int l = 0; l < (int)isos.size(); l++) {
+		MeshLevel level = {};
+		level.iso = isos[l];
+		for (auto const & slab : slabs) {
+			level.numVertexes += slab.levels[l].vtxs.size();
+			level.numTriangles += slab.levels[l].tris.size() / 3;
+		}
+		f.write(reinterpret_cast<const char*>(&level), sizeof(level));
+		std::cout << "iso " << level.iso << ": " << level.numVertexes << " vertexes, " << level.numTriangles << " triangles" << std::endl;
+	}
+
+	for (int l = 0; l < (int)isos.size(); l++) {
+		for (auto const & slab : slabs) {
+			auto const & vtxs = slab.levels[l].vtxs;
+			f.write(reinterpret_cast<const char*>(vtxs.data()), sizeof(vec3f) * vtxs.size());
+		}
+		for (auto const & slab : slabs) {
+			auto const & tris = slab.levels[l].tris;
+			f.write(reinterpret_cast<const char*>(tris.data()), sizeof(uint32_t) * tris.size());
 		}
-		float cornerValues[8];
-		getCornerValues(ipos, cornerValues);
+	}
+	std::cout << "wrote " << filename << " (" << ((long)f.tellp() >> 10) << " KB)" << std::endl;
+}
+
+void _main(std::vector<std::string> const & args) {
+	IsoBatchProcessor batch;
+	std::string datasetname = "2mrs";
+	std::string infilename, outfilename;
+	bool gotSet = false;
+	bool kde = false;
+	int kdeSize = 128;
+	float bandwidth = 0;
+
+	auto h = HandleArgs(args, {
+		{"--set", {"<set> = specify the dataset.  default is '2mrs'.", {[&](std::string s){ datasetname = s; gotSet = true; }}}},
+		{"--in", {"<file> = read this .vol or .svol instead of the dataset's density volume.", {[&](std::string s){ infilename = s; }}}},
+		{"--out", {"<file> = write here instead of datasets/<set>/isos.mesh.", {[&](std::string s){ outfilename = s; }}}},
+		{"--kde", {"= build the field from the points with a kernel density estimate instead of reading a volume.", {[&](){ kde = true; }}}},
+		{"--size", {"<n> = kde field resolution.  default is 128.", {std::function<void(int)>([&](int n){ kdeSize = n; })}}},
+		{"--bandwidth", {"<h> = kde kernel radius in world units.  default is 2 cells.", {std::function<void(float)>([&](float h){ bandwidth = h; })}}},
+		{"--iso", {"<v> = add an iso level, as a fraction of the max density.  can be given more than once.", {std::function<void(double)>([&](double v){ batch.isos.push_back((float)v); })}}},
+		{"--threads", {"<n> = specify the number of threads to use.", {std::function<void(int)>([&](int n){ batch.setNumThreads(n); })}}},
+	});
+
+	if (!gotSet && infilename.empty()) {
+		h.showhelp();
+		return;
+	}
+	if (batch.isos.empty()) throw Exception() << "expected at least one --iso";
+
+	if (infilename.empty()) {
+		std::string base = std::string() + "datasets/" + datasetname + "/density";
+		infilename = std::filesystem::exists(base + ".svol") ? base + ".svol" : base + ".vol";
+	}
+	if (outfilename.empty()) {
+		outfilename = std::string() + "datasets/" + datasetname + "/isos.mesh";
+	}
+
+	if (kde) {
+		profile("kde", [&]() {
+			batch.buildDensity(datasetname, kdeSize, bandwidth);
+		});
+	} else {
+		std::cout << "reading " << infilename << std::endl;
+		batch.field.read(infilename);
+	}
+	std::cout << "size " << batch.field.size << std::endl;
+
+	profile("genisos", [&]() {
+		batch.run();
+	});
+	batch.write(outfilename);
+}
 
+int main(int argc, char **argv) {
+	try {
+		_main({argv, argv + argc});
+	} catch (std::exception &t) {
+		std::cerr << "error: " << t.what() << std::endl;
+		return 1;
 	}
+	return 0;
 }
@@ -1,97 +1,590 @@
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
+#include <filesystem>
 #include <cstring>	//std::memset
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
 #include "exception.h"
 #include "stat.h"
 #include "util.h"
 #include "batch.h"
+#include "volume.h"
+#include "octree.h"
 
 int INTERACTIVE = 0;
 int VERBOSE = 0;
 
+/*
+one grid shared by all worker threads.
+counts are integers so dense cells keep counting past 2^24 (where float++ stops).
+the grid is split into bricks which are allocated the first time a point lands in them,
+so memory follows occupied space rather than size^3, and doesn't grow with the thread count.
+
+points are deposited with one of a few kernels.  ngp adds 1 to the cell the point lands in.
+the others spread the point over neighboring cells with separable per-axis weights,
+each axis quantized to fixed point so the sums stay integers and come out the same regardless of thread order.
+the kernels go through a bounded set of thread-private tiles, see Tiles, so no thread ever holds a copy of the grid.
+*/
+enum Deposit {
+	DEPOSIT_NGP,	//nearest grid point
+	DEPOSIT_CIC,	//cloud in cell: linear, 2 cells per axis
+	DEPOSIT_TSC,	//triangular shaped cloud: quadratic, 3 cells per axis
+	DEPOSIT_GAUSS,	//gaussian truncated at 'radius' cells, 2*radius+1 cells per axis
+};
+
 struct Volume {
+	typedef uint64_t Count;
+	static constexpr int brickBits = 4;
+	static constexpr int brickSize = 1 << brickBits;
+	static constexpr int brickMask = brickSize - 1;
+	static constexpr int brickVolume = brickSize * brickSize * brickSize;
+
+	//per-axis weights sum to this, so a kernel deposit sums to weightOne^3 per point
+	//weightOne^3 fits in 32 bits, so a cell's share of a point does too
+	static constexpr uint32_t weightOne = 1 << 10;
+	static constexpr int maxGaussRadius = 8;
+	static constexpr int maxSupport = 2 * maxGaussRadius + 1;
+	//thread-private tiles per worker before they're flushed to the grid: 1024 * 16^3 * 8 bytes = 32 MB
+	static constexpr int maxTiles = 1024;
+
+	Deposit deposit;
+	double gaussSigma;	//in cells
+	int gaussRadius;	//in cells
+
 	int size;
-	float *density;
+	int bricksPerSide;
+	std::atomic<std::atomic<Count>*> *bricks;
 	
-	int usedCount;
-	int unusedCount;
+	std::atomic<long> usedCount;
+	std::atomic<long> unusedCount;
 	
 	Volume(int size_)
-	:	size(size_),
-		density(new float[size_ * size_ * size_]),
+	:	deposit(DEPOSIT_NGP),
+		gaussSigma(1.),
+		gaussRadius(3),
+		size(0),
+		bricksPerSide(0),
+		bricks(nullptr),
 		usedCount(0),
 		unusedCount(0)
 	{
-		//init data
-		std::memset(density, 0, sizeof(float) * size * size * size);
+		resize(size_);
 	}
 
 	virtual ~Volume() {
-		delete[] density;
+		clear();
+	}
+
+	void clear() {
+		if (!bricks) return;
+		for (long i = 0; i < numBricks(); i++) {
+			delete[] bricks[i].load();
+		}
+		delete[] bricks;
+		bricks = nullptr;
+	}
+
+	void resize(int size_) {
+		if (size_ <= 0 || (size_ & brickMask)) throw Exception() << "volume size must be a positive multiple of " << brickSize << ", got " << size_;
+		clear();
+		size = size_;
+		bricksPerSide = size >> brickBits;
+		bricks = new std::atomic<std::atomic<Count>*>[numBricks()]();
+	}
+
+	long numBricks() const {
+		return (long)bricksPerSide * bricksPerSide * bricksPerSide;
+	}
+
+	long brickIndex(int x, int y, int z) const {
+		return (x >> brickBits) + bricksPerSide * ((long)(y >> brickBits) + bricksPerSide * (long)(z >> brickBits));
+	}
+
+	static int cellIndex(int x, int y, int z) {
+		return (x & brickMask) + brickSize * ((y & brickMask) + brickSize * (z & brickMask));
+	}
+
+	//thread-safe.  whoever loses the race to allocate a brick throws theirs away.
+	std::atomic<Count> *getBrick(long i) {
+		std::atomic<Count> *brick = bricks[i].load(std::memory_order_acquire);
+		if (brick) return brick;
+		std::atomic<Count> *newBrick = new std::atomic<Count>[brickVolume]();
+		if (bricks[i].compare_exchange_strong(brick, newBrick, std::memory_order_acq_rel)) return newBrick;
+		delete[] newBrick;
+		return brick;
+	}
+
+	void add(int x, int y, int z, Count n) {
+		getBrick(brickIndex(x, y, z))[cellIndex(x, y, z)].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	Count get(int x, int y, int z) const {
+		std::atomic<Count> *brick = bricks[brickIndex(x, y, z)].load(std::memory_order_relaxed);
+		return brick ? brick[cellIndex(x, y, z)].load(std::memory_order_relaxed) : 0;
+	}
+
+	//position in cells along one axis.  cell i spans [i, i+1)
+	double cellPos(float v, float min, float max) const {
+		return (double)size * (v - min) / (max - min);
+	}
+
+	void setDeposit(const std::string &name) {
+		if (name == "ngp") {
+			deposit = DEPOSIT_NGP;
+		} else if (name == "cic") {
+			deposit = DEPOSIT_CIC;
+		} else if (name == "tsc") {
+			deposit = DEPOSIT_TSC;
+		} else if (name == "gauss") {
+			deposit = DEPOSIT_GAUSS;
+		} else {
+			throw Exception() << "unknown deposit kernel " << name << ", expected ngp, cic, tsc or gauss";
+		}
 	}
 
+	void setGaussRadius(int radius) {
+		if (radius < 1 || radius > maxGaussRadius) throw Exception() << "gauss radius must be from 1 to " << maxGaussRadius << ", got " << radius;
+		gaussRadius = radius;
+	}
+
+	/*
+	fills in the first cell and the fixed-point weights of the cells a point covers along one axis.
+	u is the point position in cells, so cell i spans [i, i+1) and is centered at i+.5.
+	returns the number of cells covered.
+	*/
+	int axisWeights(double u, int &first, uint32_t *weights) const {
+		double w[maxSupport];
+		int n = 0;
+		switch (deposit) {
+		case DEPOSIT_NGP:
+			first = (int)u;
+			weights[0] = 1;
+			return 1;
+		case DEPOSIT_CIC: {
+			double d = u - .5;
+			first = (int)floor(d);
+			double f = d - first;
+			w[0] = 1. - f;
+			w[1] = f;
+			n = 2;
+			break;
+		}
+		case DEPOSIT_TSC: {
+			int i = (int)floor(u);
+			double d = u - (i + .5);
+			first = i - 1;
+			w[0] = .5 * (.5 - d) * (.5 - d);
+			w[1] = .75 - d * d;
+			w[2] = .5 * (.5 + d) * (.5 + d);
+			n = 3;
+			break;
+		}
+		case DEPOSIT_GAUSS: {
+			int i = (int)floor(u);
+			first = i - gaussRadius;
+			n = 2 * gaussRadius + 1;
+			double invTwoSigmaSq = 1. / (2. * gaussSigma * gaussSigma);
+			for (int k = 0; k < n; k++) {
+				double d = first + k + .5 - u;
+				w[k] = exp(-d * d * invTwoSigmaSq);
+			}
+			break;
+		}
+		}
+
+		//quantize, and give whatever rounding is left over to the biggest weight so each axis sums to weightOne exactly
+		double total = 0;
+		for (int k = 0; k < n; k++) total += w[k];
+		uint32_t sum = 0;
+		int biggest = 0;
+		for (int k = 0; k < n; k++) {
+			weights[k] = (uint32_t)llround(w[k] / total * (double)weightOne);
+			sum += weights[k];
+			if (w[k] > w[biggest]) biggest = k;
+		}
+		weights[biggest] += weightOne - sum;
+		return n;
+	}
+
+	/*
+	a worker's private bricks for the kernel deposits.
+	at most maxTiles are held.  when they run out, or the file is done, they're added to the shared grid and reused,
+	so a flush costs one atomic per touched cell instead of one per weight, and memory stays bounded however big the grid is.
+	*/
+	struct Tiles {
+		Volume &volume;
+		std::vector<std::unique_ptr<Count[]>> pool;	//grows up to maxTiles, zeroed whenever they're not in use
+		std::unordered_map<long, Count*> used;	//brick index -> its tile from the pool
+		long lastBrick;	//most points hit the same brick over and over
+		Count *lastTile;
+
+		Tiles(Volume &volume_) : volume(volume_), lastBrick(-1), lastTile(nullptr) {}
+
+		Count *get(long brick) {
+			if (brick == lastBrick) return lastTile;
+			auto i = used.find(brick);
+			if (i == used.end()) {
+				if ((int)used.size() == maxTiles) flush();
+				if (used.size() == pool.size()) pool.emplace_back(new Count[brickVolume]());
+				i = used.emplace(brick, pool[used.size()].get()).first;
+			}
+			lastBrick = brick;
+			lastTile = i->second;
+			return lastTile;
+		}
+
+		void flush() {
+			for (auto const & p : used) {
+				std::atomic<Count> *brick = volume.getBrick(p.first);
+				Count *tile = p.second;
+				for (int j = 0; j < brickVolume; j++) {
+					if (tile[j]) brick[j].fetch_add(tile[j], std::memory_order_relaxed);
+				}
+				std::memset(tile, 0, sizeof(Count) * brickVolume);
+			}
+			used.clear();
+			lastBrick = -1;
+		}
+	};
+
+	//one row of a kernel deposit, n cells along x within one brick.
+	//the products fit in 32 bits (see weightOne), so this vectorizes without 64-bit multiplies.
+	static void scatterRow(Count * __restrict row, const uint32_t * __restrict wx, uint32_t wyz, int n) {
+		for (int i = 0; i < n; i++) {
+			row[i] += (Count)(wyz * wx[i]);
+		}
+	}
+
+	/*
+	ngp adds straight to the shared grid, one atomic per point.
+	the kernels go through Tiles, visiting the points in brick order so each tile fills up before it's flushed,
+	rather than being flushed over and over by points scattered all over the grid.
+	kernel weight falling outside the grid is dropped.
+	*/
 	void applyFile(
 		const char *filename,
-		const float *center, 
+		const float * /*center*/,
 		const float *bmin, 
 		const float *bmax
 	) {
+		long used = 0;
+		long unused = 0;
 		std::streamsize vtxbufsize = 0;
 		float *vtxbuf = (float*)getFile(filename, &vtxbufsize);
 		float *vtxbufend = vtxbuf + (vtxbufsize / sizeof(float));
-		int ivtx[3];
-		for (float *vtx = vtxbuf; vtx < vtxbufend; vtx += 3) { 
+
+		long numVtxs = vtxbufend - vtxbuf;
+		numVtxs /= 3;
+		if (numVtxs > UINT32_MAX) throw Exception() << filename << " has too many points";
+
+		//(brick, point) for the points inside the grid, sorted
+		std::vector<std::pair<uint32_t, uint32_t>> order;
+		for (long j = 0; j < numVtxs; j++) {
+			const float *vtx = vtxbuf + 3 * j;
+			int cell[3];
+			bool inside = true;
 			for (int i = 0; i < 3; i++) {
-				ivtx[i] = (double)size * (vtx[i] - bmin[i]) / (bmax[i] - bmin[i]);
+				double u = cellPos(vtx[i], bmin[i], bmax[i]);
+				cell[i] = (int)u;
+				if (cell[i] < 0 || cell[i] >= size) inside = false;
 			}
-			if (ivtx[0] < 0 || ivtx[0] >= size ||
-				ivtx[1] < 0 || ivtx[1] >= size ||
-				ivtx[2] < 0 || ivtx[2] >= size)
-			{
-				unusedCount++;
+			if (!inside) {
+				unused++;
 				continue;
 			}
-			usedCount++;
-			
-			density[ivtx[0] + size * (ivtx[1] + size * ivtx[2])]++;
+			used++;
+			if (deposit == DEPOSIT_NGP) {
+				add(cell[0], cell[1], cell[2], 1);
+			} else {
+				order.push_back(std::make_pair((uint32_t)brickIndex(cell[0], cell[1], cell[2]), (uint32_t)j));
+			}
 		}
-		delete[] vtxbuf;
-	}
+		std::sort(order.begin(), order.end());
 
-	void accumulate(const Volume &v) {
-		assert(size == v.size);
-		for (int i = 0; i < size * size * size; i++) {
-			density[i] += v.density[i];
+		Tiles tiles(*this);
+		int first[3];
+		int n[3];
+		uint32_t weights[3][maxSupport];
+		for (auto const & o : order) {
+			const float *vtx = vtxbuf + 3 * (long)o.second;
+			for (int i = 0; i < 3; i++) {
+				n[i] = axisWeights(cellPos(vtx[i], bmin[i], bmax[i]), first[i], weights[i]);
+			}
+
+			//clip the footprint to the grid once, rather than per cell
+			int lo[3], hi[3];
+			for (int i = 0; i < 3; i++) {
+				lo[i] = std::max(first[i], 0);
+				hi[i] = std::min(first[i] + n[i], size);
+			}
+			for (int z = lo[2]; z < hi[2]; z++) {
+				uint32_t wz = weights[2][z - first[2]];
+				for (int y = lo[1]; y < hi[1]; y++) {
+					uint32_t wyz = wz * weights[1][y - first[1]];
+					//a row can cross into the next brick or two
+					for (int x = lo[0]; x < hi[0];) {
+						int xEnd = std::min(hi[0], (x | brickMask) + 1);
+						Count *row = tiles.get(brickIndex(x, y, z)) + cellIndex(x, y, z);
+						scatterRow(row, weights[0] + (x - first[0]), wyz, xEnd - x);
+						x = xEnd;
+					}
+				}
+			}
 		}
-		unusedCount += v.unusedCount;
-		usedCount += v.usedCount;
+		delete[] vtxbuf;
+		tiles.flush();
+
+		usedCount += used;
+		unusedCount += unused;
 	}
 
+	//not thread-safe.  call once the workers are done.
 	void write(const std::string &outfilename) {
-		float maxDensity = 0;
-		for (int i = 0; i < size * size * size; i++) {
-			float &densityRef = density[i];
-			if (densityRef > maxDensity) maxDensity = densityRef;
+		Count maxDensity = 0;
+		long numUsedBricks = 0;
+		for (long i = 0; i < numBricks(); i++) {
+			std::atomic<Count> *brick = bricks[i].load();
+			if (!brick) continue;
+			numUsedBricks++;
+			for (int j = 0; j < brickVolume; j++) {
+				Count c = brick[j].load(std::memory_order_relaxed);
+				if (c > maxDensity) maxDensity = c;
+			}
 		}
 		
 		std::cout << "max cell density " << maxDensity << std::endl;
 		assert(maxDensity > 0);
-		//...and normalize ... and write out ...
-		float invMaxDensity = 1. / maxDensity;
+
+		std::ofstream f(outfilename.c_str(), std::ios::out | std::ios::binary);
+		if (!f.is_open()) throw Exception() << "failed to open " << outfilename << " for writing";
+
+		//...and normalize ... and write out, a slice at a time ...
+		double invMaxDensity = 1. / (double)maxDensity;
 		long int numNonzeroCells = 0;
-		for (int i = 0; i < size * size * size; i++) {
-			density[i] *= invMaxDensity;	
-			if (density[i]) numNonzeroCells++;
+		std::vector<float> slice(size * size);
+		for (int z = 0; z < size; z++) {
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++) {
+					float &density = slice[x + size * y];
+					density = (float)((double)get(x, y, z) * invMaxDensity);
+					if (density) numNonzeroCells++;
+				}
+			}
+			f.write(reinterpret_cast<char *>(slice.data()), sizeof(float) * slice.size());
 		}
 		std::cout << usedCount << " points used" << std::endl;
 		std::cout << unusedCount << " points are out of bounds" << std::endl;
 		std::cout << (100. * (double)numNonzeroCells / ((double)size * size * size)) << "% of volume cells are nonzero" << std::endl;
+		std::cout << numUsedBricks << " of " << numBricks() << " bricks allocated (" << (numUsedBricks * brickVolume * sizeof(Count) >> 20) << " MB)" << std::endl;
+	}
+
+	template<typename Cell>
+	static void encodeCellsAs(SparseVolumeHeader const & header, std::vector<Count> const & counts, std::vector<char> &out) {
+		out.resize(sizeof(Cell) * counts.size());
+		Cell *cells = reinterpret_cast<Cell*>(out.data());
+		double maxCellValue = header.maxCellValue();
+		for (size_t i = 0; i < counts.size(); i++) {
+			double value = header.encode((double)counts[i]) * maxCellValue;
+			cells[i] = std::is_floating_point<Cell>::value ? (Cell)value : (Cell)lround(value);
+		}
+	}
+
+	//counts -> cells in header's encoding and transfer
+	static void encodeCells(SparseVolumeHeader const & header, std::vector<Count> const & counts, std::vector<char> &out) {
+		switch (header.encoding) {
+		case VOLUME_ENCODING_F32: encodeCellsAs<float>(header, counts, out); break;
+		case VOLUME_ENCODING_U8: encodeCellsAs<uint8_t>(header, counts, out); break;
+		case VOLUME_ENCODING_U16: encodeCellsAs<uint16_t>(header, counts, out); break;
+		}
+	}
+
+	static void writeCells(std::ofstream &f, SparseVolumeHeader const & header, std::vector<Count> const & counts) {
+		std::vector<char> out;
+		encodeCells(header, counts, out);
+		f.write(out.data(), out.size());
+	}
+
+	/*
+	writes a .svol, see volume.h for the layout.
+	sparse writes only bricks with something in them, otherwise the whole grid goes out as one brick.
+	transferScale is in counts.
+	*/
+	void writeEncoded(const std::string &outfilename, bool sparse, uint32_t encoding, uint32_t transfer, double transferScale) {
+		Count maxDensity = 0;
+		std::vector<uint32_t> brickIndexes;
+		for (long i = 0; i < numBricks(); i++) {
+			std::atomic<Count> *brick = bricks[i].load();
+			if (!brick) continue;
+			Count brickMax = 0;
+			for (int j = 0; j < brickVolume; j++) {
+				Count c = brick[j].load(std::memory_order_relaxed);
+				if (c > brickMax) brickMax = c;
+			}
+			if (!brickMax) continue;
+			brickIndexes.push_back((uint32_t)i);
+			if (brickMax > maxDensity) maxDensity = brickMax;
+		}
+
+		std::cout << "max cell density " << maxDensity << std::endl;
+		assert(maxDensity > 0);
 
 		std::ofstream f(outfilename.c_str(), std::ios::out | std::ios::binary);
 		if (!f.is_open()) throw Exception() << "failed to open " << outfilename << " for writing";
-		f.write(reinterpret_cast<char *>(density), sizeof(float) * size * size * size);
+
+		SparseVolumeHeader header = {};
+		std::memcpy(header.magic, SparseVolumeHeader::signature, sizeof(header.magic));
+		header.version = SparseVolumeHeader::currentVersion;
+		header.size = size;
+		header.brickSize = sparse ? brickSize : size;
+		header.numBricks = sparse ? brickIndexes.size() : 1;
+		header.encoding = encoding;
+		header.maxCount = (double)maxDensity;
+		header.transfer = transfer;
+		header.transferScale = transferScale;
+		f.write(reinterpret_cast<char*>(&header), sizeof(header));
+
+		if (sparse) {
+			f.write(reinterpret_cast<char*>(brickIndexes.data()), sizeof(uint32_t) * brickIndexes.size());
+			std::vector<Count> counts(brickVolume);
+			for (uint32_t i : brickIndexes) {
+				std::atomic<Count> *brick = bricks[i].load();
+				for (int j = 0; j < brickVolume; j++) {
+					counts[j] = brick[j].load(std::memory_order_relaxed);
+				}
+				writeCells(f, header, counts);
+			}
+		} else {
+			uint32_t brickIndex = 0;
+			f.write(reinterpret_cast<char*>(&brickIndex), sizeof(brickIndex));
+			std::vector<Count> counts((long)size * size);
+			for (int z = 0; z < size; z++) {
+				for (int y = 0; y < size; y++) {
+					for (int x = 0; x < size; x++) {
+						counts[x + size * y] = get(x, y, z);
+					}
+				}
+				writeCells(f, header, counts);
+			}
+		}
+		std::cout << usedCount << " points used" << std::endl;
+		std::cout << unusedCount << " points are out of bounds" << std::endl;
+		if (sparse) std::cout << brickIndexes.size() << " of " << numBricks() << " bricks written" << std::endl;
+		std::cout << "wrote " << ((long)f.tellp() >> 20) << " MB" << std::endl;
+	}
+
+	/*
+	mip pyramid for the web viewer.
+	level 0 is full res, each level after sums 2x2x2 cells of the level before, down to a single brick.
+	each level is written to <dir>/level<n>.bin as brickSize^3 cells per brick, encoded like a .svol's cells against that level's max,
+	with bricks that encode to all zeros left out.
+	<dir>/index.json lists each level's bricks as [brick index, byte offset, byte size], in file order,
+	so the viewer can fetch just the bricks it needs with range requests.
+	transferScale is in counts.
+	*/
+	void writeBricks(const std::string &dir, const float *bmin, const float *bmax, uint32_t encoding, uint32_t transfer, double transferScale) const {
+		static const char *encodingNames[NUM_VOLUME_ENCODINGS] = {"f32", "u8", "u16"};
+		static const char *transferNames[NUM_VOLUME_TRANSFERS] = {"linear", "log", "asinh"};
+
+		struct MipLevel {
+			int size, bricksPerSide;
+			std::vector<std::vector<Count>> bricks;	//empty means no points
+			MipLevel(int size_)
+			: size(size_),
+				bricksPerSide(size_ >> brickBits),
+				bricks((long)bricksPerSide * bricksPerSide * bricksPerSide)
+			{}
+		};
+
+		std::filesystem::create_directory(dir);
+		std::ofstream index(dir + "/index.json");
+		if (!index.is_open()) throw Exception() << "failed to open " << dir << "/index.json for writing";
+		index << "{" << std::endl
+			<< "\t\"brickSize\" : " << brickSize << "," << std::endl
+			<< "\t\"min\" : [" << bmin[0] << ", " << bmin[1] << ", " << bmin[2] << "]," << std::endl
+			<< "\t\"max\" : [" << bmax[0] << ", " << bmax[1] << ", " << bmax[2] << "]," << std::endl
+			<< "\t\"encoding\" : \"" << encodingNames[encoding] << "\"," << std::endl
+			<< "\t\"transfer\" : \"" << transferNames[transfer] << "\"," << std::endl
+			<< "\t\"transferScale\" : " << std::setprecision(17) << transferScale << std::setprecision(6) << "," << std::endl
+			<< "\t\"levels\" : [" << std::endl;
+
+		MipLevel level(size);
+		for (long i = 0; i < numBricks(); i++) {
+			std::atomic<Count> *brick = bricks[i].load();
+			if (!brick) continue;
+			level.bricks[i].resize(brickVolume);
+			for (int j = 0; j < brickVolume; j++) {
+				level.bricks[i][j] = brick[j].load(std::memory_order_relaxed);
+			}
+		}
+
+		for (int levelIndex = 0;; levelIndex++) {
+			Count maxDensity = 0;
+			for (auto const & brick : level.bricks) {
+				for (Count c : brick) {
+					if (c > maxDensity) maxDensity = c;
+				}
+			}
+			SparseVolumeHeader header = {};
+			header.encoding = encoding;
+			header.maxCount = (double)(maxDensity ? maxDensity : 1);
+			header.transfer = transfer;
+			header.transferScale = transferScale;
+
+			std::string levelFilename = std::string() + "level" + std::to_string(levelIndex) + ".bin";
+			std::ofstream f(dir + "/" + levelFilename, std::ios::out | std::ios::binary);
+			if (!f.is_open()) throw Exception() << "failed to open " << dir << "/" << levelFilename << " for writing";
+			index << (levelIndex ? "," : "") << "\t\t{" << std::endl
+				<< "\t\t\t\"size\" : " << level.size << "," << std::endl
+				<< "\t\t\t\"file\" : \"" << levelFilename << "\"," << std::endl
+				<< "\t\t\t\"maxCount\" : " << maxDensity << "," << std::endl
+				<< "\t\t\t\"bricks\" : [";
+			std::vector<char> out;
+			int numWritten = 0;
+			long offset = 0;
+			for (long i = 0; i < (long)level.bricks.size(); i++) {
+				auto const & brick = level.bricks[i];
+				if (brick.empty()) continue;
+				encodeCells(header, brick, out);
+				//u8 and u16 round the faintest bricks away
+				if (std::all_of(out.begin(), out.end(), [](char c) { return !c; })) continue;
+				f.write(out.data(), out.size());
+				index << (numWritten ? ", " : "") << "[" << i << ", " << offset << ", " << out.size() << "]";
+				offset += out.size();
+				numWritten++;
+			}
+			index << "]" << std::endl << "\t\t}";
+			std::cout << "level " << levelIndex << " size " << level.size << " wrote " << numWritten << " of " << level.bricks.size() << " bricks" << std::endl;
+
+			int nextSize = level.size >> 1;
+			if (nextSize < brickSize || (nextSize & brickMask)) break;
+			MipLevel next(nextSize);
+			for (long i = 0; i < (long)level.bricks.size(); i++) {
+				auto const & brick = level.bricks[i];
+				if (brick.empty()) continue;
+				int bx = i % level.bricksPerSide;
+				int by = (i / level.bricksPerSide) % level.bricksPerSide;
+				int bz = i / ((long)level.bricksPerSide * level.bricksPerSide);
+				for (int j = 0; j < brickVolume; j++) {
+					if (!brick[j]) continue;
+					int x = ((bx << brickBits) + (j & brickMask)) >> 1;
+					int y = ((by << brickBits) + ((j >> brickBits) & brickMask)) >> 1;
+					int z = ((bz << brickBits) + (j >> (2 * brickBits))) >> 1;
+					auto & dst = next.bricks[(x >> brickBits) + next.bricksPerSide * ((long)(y >> brickBits) + next.bricksPerSide * (long)(z >> brickBits))];
+					if (dst.empty()) dst.resize(brickVolume);
+					dst[cellIndex(x, y, z)] += brick[j];
+				}
+			}
+			level = std::move(next);
+		}
+		index << std::endl << "\t]" << std::endl << "}" << std::endl;
 	}
 };
 
@@ -99,45 +592,45 @@ struct VolumeBatchProcessor;
 
 struct VolumeWorker {
 	VolumeBatchProcessor &batch;
-	Volume volume;
-	typedef std::string ArgType;
-	std::string desc(const ArgType &basename);
+	typedef std::string ArgType;	//point file, relative to the dataset dir
+	std::string desc(const ArgType &filename);
 
 	VolumeWorker(BatchProcessor<VolumeWorker> *batch_);
-	~VolumeWorker();
 
-	void operator()(const ArgType &basename);
+	void operator()(const ArgType &filename);
 };
 
 struct VolumeBatchProcessor : public BatchProcessor<VolumeWorker> {
 	StatSet totalStats;
 	float center[3], bmin[3], bmax[3];
 	Volume volume;
-	std::mutex volumeMutex;
 	std::string datasetname;
+	bool writeBricks;
+	bool sparse;
+	uint32_t encoding;	//VOLUME_ENCODING_*
+	uint32_t transfer;	//VOLUME_TRANSFER_*
+	double transferScale;	//in points
+
+	long numNodesFromMetadata;
+	long numNodesToRead;
 
 	VolumeBatchProcessor();
 	void init();
+	void addOctree(OctreeNode *node);
 	void done();
 };
 
 VolumeWorker::VolumeWorker(BatchProcessor<VolumeWorker> *batch_)
-:	batch(*(VolumeBatchProcessor*)batch_),
-	volume(batch.volume.size)
+:	batch(*(VolumeBatchProcessor*)batch_)
 {}
 
-VolumeWorker::~VolumeWorker() {
-	std::unique_lock<std::mutex> volumeCS(batch.volumeMutex);
-	batch.volume.accumulate(volume);
-}
-
-std::string VolumeWorker::desc(const ArgType &basename) {
-	return std::string() + "file " + basename;
+std::string VolumeWorker::desc(const ArgType &filename) {
+	return std::string() + "file " + filename;
 }
 
-void VolumeWorker::operator()(const ArgType &basename) {
-	std::string ptfilename = std::string("datasets/") + batch.datasetname + "/points/" + basename + ".f32";
-	volume.applyFile(
+void VolumeWorker::operator()(const ArgType &filename) {
+	std::string ptfilename = std::string("datasets/") + batch.datasetname + "/" + filename;
+	batch.volume.applyFile(
 		ptfilename.c_str(), 
 		batch.center, 
 		batch.bmin, 
@@ -147,7 +640,14 @@ void VolumeWorker::operator()(const ArgType &basename) {
 VolumeBatchProcessor::VolumeBatchProcessor()
 : 	BatchProcessor<VolumeWorker>(),
 	volume(256),
-	datasetname("allsky")
+	datasetname("allsky"),
+	writeBricks(false),
+	sparse(false),
+	encoding(VOLUME_ENCODING_F32),
+	transfer(VOLUME_TRANSFER_LINEAR),
+	transferScale(1),
+	numNodesFromMetadata(0),
+	numNodesToRead(0)
 {
 }
 
@@ -175,35 +675,115 @@ void VolumeBatchProcessor::init() {
 	std::cout << "max " << bmax[0] << ", " << bmax[1] << ", " << bmax[2] << std::endl;
 }
 
+/*
+--octree walks genoctree's leaves instead of the raw point files.
+with ngp, a leaf whose bbox lands in a single cell adds its point count there and its file is never read.
+everything else is queued for the workers.
+call after init(), which sets up bmin and bmax.
+*/
+void VolumeBatchProcessor::addOctree(OctreeNode *node) {
+	if (!node->leaf) {
+		for (int i = 0; i < numberof(node->ch); i++) {
+			if (node->ch[i]) addOctree(node->ch[i]);
+		}
+		return;
+	}
+	if (node->numPoints <= 0) return;
+
+	if (volume.deposit == DEPOSIT_NGP) {
+		int cell[3];
+		bool oneCell = true;
+		bool inside = true;
+		for (int i = 0; i < 3; i++) {
+			cell[i] = (int)volume.cellPos(node->bbox.min[i], bmin[i], bmax[i]);
+			if (cell[i] != (int)volume.cellPos(node->bbox.max[i], bmin[i], bmax[i])) oneCell = false;
+			if (cell[i] < 0 || cell[i] >= volume.size) inside = false;
+		}
+		if (oneCell) {
+			if (inside) {
+				volume.add(cell[0], cell[1], cell[2], node->numPoints);
+				volume.usedCount += node->numPoints;
+			} else {
+				volume.unusedCount += node->numPoints;
+			}
+			numNodesFromMetadata++;
+			return;
+		}
+	}
+	addThreadArg(node->getFileName());
+	numNodesToRead++;
+}
+
 void VolumeBatchProcessor::done() {
-	volume.write(std::string() + "datasets/" + datasetname + "/density.vol");
+	//a point is one count for ngp, weightOne^3 for the kernels
+	double countsPerPoint = volume.deposit == DEPOSIT_NGP ? 1. : pow((double)Volume::weightOne, 3.);
+	if (sparse || encoding != VOLUME_ENCODING_F32 || transfer != VOLUME_TRANSFER_LINEAR) {
+		volume.writeEncoded(std::string() + "datasets/" + datasetname + "/density.svol", sparse, encoding, transfer, transferScale * countsPerPoint);
+	} else {
+		volume.write(std::string() + "datasets/" + datasetname + "/density.vol");
+	}
+	if (writeBricks) {
+		volume.writeBricks(std::string() + "datasets/" + datasetname + "/density-bricks", bmin, bmax, encoding, transfer, transferScale * countsPerPoint);
+	}
 }
 
 void _main(std::vector<std::string> const & args) {
-	bool gotDir = false, gotFile = false;
+	bool gotDir = false, gotFile = false, gotOctree = false;
 	VolumeBatchProcessor batch;
 	int totalFiles = 0;
 
 	auto h = HandleArgs(args, {
 		{"--set", {"<set> = specify the dataset.  default is 'allsky'", {[&](std::string s){ batch.datasetname = s; }}}},
 		{"--all", {"= convert all files in the allsky-gz dir.", {[&](){ gotDir = true; }}}},
-		{"--file", {"<file> = convert only this file.  omit path and ext.", {[&](std::string s){ gotFile = true; batch.addThreadArg(s); ++totalFiles; }}}},
+		{"--file", {"<file> = convert only this file.  omit path and ext.", {[&](std::string s){ gotFile = true; batch.addThreadArg("points/" + s + ".f32"); ++totalFiles; }}}},
+		{"--octree", {"= read genoctree's nodes instead of the point files, so not with --all or --file.  with ngp, nodes inside one cell are counted without being read.", {[&](){ gotOctree = true; }}}},
 		{"--verbose", {"= shows verbose information.", {[&](){ VERBOSE = 1; }}}},
 		{"--wait", {"= waits for key at each entry.  implies verbose.", {[&](){ VERBOSE = 1; INTERACTIVE = 1; }}}},
 		{"--threads", {"<n> = specify the number of threads to use.", {std::function<void(int)>([&](int n){ batch.setNumThreads(n); })}}},
+		{"--size", {"<n> = volume resolution, a multiple of 16.  default is 256.", {std::function<void(int)>([&](int n){ batch.volume.resize(n); })}}},
+		{"--deposit", {"<kernel> = how points are spread into cells: ngp, cic, tsc or gauss.  default is ngp.", {[&](std::string s){ batch.volume.setDeposit(s); }}}},
+		{"--sigma", {"<cells> = gaussian deposit standard deviation, in cells.  default is 1.", {std::function<void(double)>([&](double sigma){ batch.volume.gaussSigma = sigma; })}}},
+		{"--radius", {"<cells> = gaussian deposit cutoff, in cells.  default is 3.", {std::function<void(int)>([&](int radius){ batch.volume.setGaussRadius(radius); })}}},
+		{"--sparse", {"= write only the occupied bricks to density.svol instead of the whole grid to density.vol.", {[&](){ batch.sparse = true; }}}},
+		{"--encoding", {"<f32|u8|u16> = cell format of density.svol and density-bricks/.  anything but f32 implies writing density.svol.  default is f32.", {[&](std::string s){
+			if (s == "f32") {
+				batch.encoding = VOLUME_ENCODING_F32;
+			} else if (s == "u8") {
+				batch.encoding = VOLUME_ENCODING_U8;
+			} else if (s == "u16") {
+				batch.encoding = VOLUME_ENCODING_U16;
+			} else {
+				throw Exception() << "unknown encoding " << s;
+			}
+		}}}},
+		{"--transfer", {"<linear|log|asinh> = how counts map to cell values in density.svol and density-bricks/.  anything but linear implies writing density.svol.  default is linear.", {[&](std::string s){
+			if (s == "linear") {
+				batch.transfer = VOLUME_TRANSFER_LINEAR;
+			} else if (s == "log") {
+				batch.transfer = VOLUME_TRANSFER_LOG;
+			} else if (s == "asinh") {
+				batch.transfer = VOLUME_TRANSFER_ASINH;
+			} else {
+				throw Exception() << "unknown transfer " << s;
+			}
+		}}}},
+		{"--transfer-scale", {"<points> = density, in points per cell, where log and asinh go from linear to logarithmic.  default is 1.", {std::function<void(double)>([&](double x){ batch.transferScale = x; })}}},
+		{"--bricks", {"= also write a mip pyramid of bricks to density-bricks/ for the web viewer, in --encoding and --transfer.  it reads just the bricks it shows.", {[&](){ batch.writeBricks = true; }}}},
 	});
 
-	if (!gotDir && !gotFile) {
+	if (!gotDir && !gotFile && !gotOctree) {
 		h.showhelp();
 		return;
 	}
+	//the octree holds the same points as points/, so both would count every point twice
+	if (gotOctree && (gotDir || gotFile)) throw Exception() << "expected --octree or --all/--file, not both";
 
 	if (gotDir) {
 		for (auto const & i : getDirFileNames(std::string() + "datasets/" + batch.datasetname + "/points")) {
 			std::string base, ext;
 			getFileNameParts(i, base, ext);
 			if (ext == "f32") {
-				batch.addThreadArg(base);
+				batch.addThreadArg("points/" + i);
 				totalFiles++;
 			}	
 		}
@@ -211,6 +791,14 @@ void _main(std::vector<std::string> const & args) {
 
 	batch.init();
 
+	if (gotOctree) {
+		OctreeNode *root = OctreeNode::readSet(batch.datasetname);
+		batch.addOctree(root);
+		delete root;
+		totalFiles += batch.numNodesToRead;
+		std::cout << batch.numNodesFromMetadata << " octree nodes counted without reading, " << batch.numNodesToRead << " to read" << std::endl;
+	}
+
 	double deltaTime = profile("genvolume", [&]() {
 		batch(); 
 	});
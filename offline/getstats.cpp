@@ -11,6 +11,7 @@
 #include "batch.h"
 
 int FORCE = 0;
+int WRITE_TEXT = 0;
 
 struct StatBatchProcessor;
 
@@ -73,8 +74,6 @@ void StatWorker::operator()(const ArgType &basename) {
 	float const * const vtxbuf = (float*)getFile(ptfilename, &vtxbufsize);
 	float const * const vtxbufend = vtxbuf + (vtxbufsize / sizeof(float));
 	for (float const * vtx = vtxbuf; vtx < vtxbufend; vtx += 3) { 
-		double values[NUM_STATSET_VARS];
-	
 		if (batch->useTotalStats) {
 			//filter x y z
 			if ((vtx[0] < batch->totalStats.x.avg - 3 * batch->totalStats.x.stddev) ||
@@ -89,19 +88,16 @@ void StatWorker::operator()(const ArgType &basename) {
 			}
 		}
 
-		values[STATSET_X] = vtx[0];
-		values[STATSET_Y] = vtx[1];
-		values[STATSET_Z] = vtx[2];
-		values[STATSET_R] = sqrt(values[STATSET_X]*values[STATSET_X] + values[STATSET_Y]*values[STATSET_Y] + values[STATSET_Z]*values[STATSET_Z]);
-		values[STATSET_PHI] = atan2(values[STATSET_Y], values[STATSET_X]);
-		values[STATSET_THETA] = acos(values[STATSET_Z] / values[STATSET_R]);
-
-		stats.accum(values);
+		stats.accumPoint(vtx[0], vtx[1], vtx[2]);
 	}
 	delete[] vtxbuf;
 
 	stats.calcStdDev();
-	stats.write(statsFilename);
+	if (WRITE_TEXT) {
+		stats.writeText(statsFilename);
+	} else {
+		stats.write(statsFilename);
+	}
 }
 
 StatBatchProcessor::StatBatchProcessor()
@@ -132,6 +128,7 @@ void showhelp() {
 	<< "    --force              " << std::endl
 	<< "    --threads " << std::endl
 	<< "    --remove-outliers    use the stats/total.stats file to remove outliers." << std::endl
+	<< "    --text               write the stats in the old text format." << std::endl
 	;
 }
 
@@ -161,6 +158,9 @@ void _main(std::vector<std::string> const & args) {
 		{"--remove-outliers", {"use the stats/total.stats file to remove outliers.", {[&](){
 			removeOutliers = true;
 		}}}},
+		{"--text", {"= write the stats in the old text format instead of binary.", {[&](){
+			WRITE_TEXT = 1;
+		}}}},
 	});
 
 	if (!gotDir && !gotFile) {
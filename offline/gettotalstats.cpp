@@ -5,9 +5,11 @@
 struct TotalStatWorker {
 	std::list<std::string> files;
 	std::string datasetname;
+	bool writeText;
 
-	TotalStatWorker(const std::string &datasetname_) 
-	: datasetname(datasetname_)
+	TotalStatWorker(const std::string &datasetname_, bool writeText_) 
+	: datasetname(datasetname_),
+		writeText(writeText_)
 	{
 		for (auto const & i : getDirFileNames(std::string() + "datasets/" + datasetname + "/points")) {
 			std::string base, ext;
@@ -16,6 +18,8 @@ struct TotalStatWorker {
 				files.push_back(base);
 			}
 		}
+		//directory order isn't stable.  merge in name order so the totals are bit-reproducible.
+		files.sort();
 	}
 	
 	void operator()() {
@@ -26,24 +30,32 @@ struct TotalStatWorker {
 			
 			StatSet stats;
 			stats.read(statsfilename);
-			stats.calcSqAvg();
 			totalStats.accum(stats);
 		}
 
 		totalStats.calcStdDev();
-		totalStats.write(std::string() + "datasets/" + datasetname + "/stats/total.stats");
+		std::string const totalfilename = std::string() + "datasets/" + datasetname + "/stats/total.stats";
+		if (writeText) {
+			totalStats.writeText(totalfilename);
+		} else {
+			totalStats.write(totalfilename);
+		}
 	}
 };
 
 void _main(std::vector<std::string> const & args) {
 	std::string datasetname = "allsky";
+	bool writeText = false;
 	HandleArgs(args, {
 		{"--set", {"<set> = specify the dataset.  default is 'allsky'.", {[&](std::string s){
 			datasetname = s;
 		}}}},
+		{"--text", {"= write total.stats in the old text format instead of binary.", {[&](){
+			writeText = true;
+		}}}},
 	});
 
-	TotalStatWorker totalWorker(datasetname);
+	TotalStatWorker totalWorker(datasetname, writeText);
 	int totalFiles = totalWorker.files.size();
 	double deltaTime = profile("get total", [&]() {
 		totalWorker();
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <zlib.h>
+
+#include "gzip.h"
+#include "exception.h"
+
+GZipReader::GZipReader(std::string const & filename_) : file(nullptr), filename(filename_) {
+	file = gzopen(filename.c_str(), "rb");
+	if (!file) throw Exception() << "failed to open file " << filename;
+	gzbuffer(file, 1 << 20);	//default is 8k
+}
+
+GZipReader::~GZipReader() {
+	if (file) gzclose(file);
+}
+
+size_t GZipReader::read(char *dst, size_t dstlen) {
+	size_t total = 0;
+	while (total < dstlen) {
+		//gzread takes an unsigned
+		unsigned n = (unsigned)std::min<size_t>(dstlen - total, 1u << 30);
+		int got = gzread(file, dst + total, n);
+		if (got < 0) {
+			int err = 0;
+			const char *msg = gzerror(file, &err);
+			throw Exception() << "failed to read " << filename << ": " << msg;
+		}
+		if (!got) {
+			//gzread stops early on a truncated stream
+			int err = 0;
+			const char *msg = gzerror(file, &err);
+			if (err != Z_OK) throw Exception() << "failed to read " << filename << ": " << msg;
+			break;
+		}
+		total += got;
+	}
+	return total;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+struct gzFile_s;
+
+//reads a gzip file, decompressing as it goes, so nothing is extracted to disk.
+//files that aren't gzipped are read as-is.
+struct GZipReader {
+	GZipReader(std::string const & filename);
+	~GZipReader();
+	GZipReader(const GZipReader &) = delete;
+	GZipReader &operator=(const GZipReader &) = delete;
+
+	//reads up to dstlen decompressed bytes.  returns how many, 0 at the end of the file.
+	size_t read(char *dst, size_t dstlen);
+
+protected:
+	gzFile_s *file;
+	std::string filename;
+};
@@ -0,0 +1,130 @@
+/*
+builds datasets/<set>/catalog.idx, an identifier -> row index over datasets/<set>/catalog.dat,
+and datasets/<set>/catalog.search, a trigram index for substring searches over the same columns.
+run it after convert-2mrs or convert-simbad.lua
+
+index-catalog --set 2mrs
+index-catalog --set 2mrs --find "NGC 1208"
+index-catalog --set 2mrs --search "ngc 12" --limit 10
+*/
+#include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include "exception.h"
+#include "util.h"
+#include "catalog.h"
+#include "catalogindex.h"
+#include "catalogsearch.h"
+
+//indexed when no --column is given, whichever the catalog has
+const char *defaultColumns[] = {
+	"_2MASS_ID",	//2mrs
+	"galaxyName",	//2mrs
+	"id",	//simbad
+};
+
+void _main(std::vector<std::string> const & args) {
+	std::string setname;
+	std::vector<std::string> columnNames;
+	std::vector<std::string> finds;
+	std::vector<std::string> searches;
+	int limit = 20;
+	auto h = HandleArgs(args, {
+		{"--set", {"<name> = use datasets/<name>/catalog.dat and catalog.specs", {[&](std::string s){ setname = s; }}}},
+		{"--column", {"<name> = index this column, for both lookups and searches.  can be repeated.  default is whichever of _2MASS_ID galaxyName id are there", {[&](std::string s){ columnNames.push_back(s); }}}},
+		{"--find", {"<ident> = look up an identifier in the existing index instead of building it.  can be repeated", {[&](std::string s){ finds.push_back(s); }}}},
+		{"--search", {"<text> = find rows with this in their names, in the existing search index.  can be repeated", {[&](std::string s){ searches.push_back(s); }}}},
+		{"--limit", {"<n> = most rows --search shows.  default 20", {std::function<void(int)>([&](int n){ limit = n; })}}},
+	});
+	if (setname.empty()) {
+		std::cout << "expected --set" << std::endl;
+		h.showhelp();
+		return;
+	}
+
+	std::string dir = std::string() + "datasets/" + setname;
+	CatalogReader catalog(dir + "/catalog.dat", dir + "/catalog.specs");
+	std::string indexFilename = dir + "/catalog.idx";
+	std::string searchFilename = dir + "/catalog.search";
+
+	auto printRow = [&](uint32_t row) {
+		std::cout << "\t" << row;
+		for (size_t j = 0; j < catalog.columns.size(); j++) {
+			std::cout << "\t" << catalog.columns[j].name << "=" << catalog.field(row, j);
+		}
+		std::cout << std::endl;
+	};
+
+	if (!searches.empty()) {
+		CatalogSearch search(searchFilename);
+		if (search.header->catalogSize != catalog.file.size()) {
+			std::cerr << "warning: " << searchFilename << " was built from a different catalog.dat.  run index-catalog --set " << setname << " again." << std::endl;
+		}
+		for (auto const & text : searches) {
+			std::vector<CatalogSearch::Match> matches;
+			profile("search", [&](){
+				matches = search.find(text, std::max(0, limit));
+			});
+			std::cout << "\"" << text << "\": " << matches.size() << " rows" << std::endl;
+			for (auto const & m : matches) {
+				if (m.row >= catalog.numRows()) continue;
+				printRow(m.row);
+			}
+		}
+	}
+
+	if (!finds.empty()) {
+		CatalogIndex index(indexFilename);
+		if (index.header->catalogSize != catalog.file.size()) {
+			std::cerr << "warning: " << indexFilename << " was built from a different catalog.dat.  run index-catalog --set " << setname << " again." << std::endl;
+		}
+		for (auto const & ident : finds) {
+			CatalogIndex::Rows rows;
+			profile("find", [&](){
+				rows = index.find(ident);
+			});
+			std::cout << "\"" << ident << "\": " << rows.size() << " rows" << std::endl;
+			for (const uint32_t *r = rows.begin; r < rows.end; r++) {
+				if (*r >= catalog.numRows()) continue;
+				printRow(*r);
+			}
+		}
+	}
+
+	if (!finds.empty() || !searches.empty()) return;
+
+	std::vector<int> columns;
+	if (columnNames.empty()) {
+		for (const char *name : defaultColumns) {
+			int j = catalog.findColumn(name);
+			if (j != -1) columns.push_back(j);
+		}
+		if (columns.empty()) throw Exception() << "none of the default columns are in " << dir << "/catalog.specs, use --column";
+	} else {
+		for (auto const & name : columnNames) {
+			int j = catalog.findColumn(name);
+			if (j == -1) throw Exception() << "no column " << name << " in " << dir << "/catalog.specs";
+			columns.push_back(j);
+		}
+	}
+
+	profile("index-catalog", [&](){
+		writeCatalogIndex(indexFilename, catalog, columns);
+	});
+	profile("search index", [&](){
+		writeCatalogSearch(searchFilename, catalog, columns);
+	});
+	CatalogIndex index(indexFilename);
+	CatalogSearch search(searchFilename);
+	std::cout << "indexed " << index.header->numRows << " rows, " << index.header->numKeys << " identifiers, " << search.header->numGrams << " trigrams" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	try {
+		_main({argv, argv + argc});
+	} catch (std::exception & t) {
+		std::cerr << "error: " << t.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,298 @@
+#include <cmath>
+#include <cstring>	//std::memchr
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <atomic>
+
+#include "ingest.h"
+#include "fields.h"
+#include "gzip.h"
+#include "util.h"
+#include "exception.h"
+
+void IngestSpec::validate() const {
+	int roleCounts[INGEST_LABEL + 1] = {0};
+	for (auto const & col : columns) {
+		if (col.index < 0) throw Exception() << "column " << col.name << " has a negative index";
+		bool wantsString = col.role == INGEST_LABEL;
+		bool anyType = col.role == INGEST_VALUE;
+		if (!anyType && wantsString != (col.type == INGEST_STRING)) throw Exception() << "column " << col.name << " has the wrong type for its role";
+		roleCounts[col.role]++;
+	}
+	for (int role : {INGEST_RA, INGEST_DEC, INGEST_LON, INGEST_LAT, INGEST_REDSHIFT}) {
+		if (roleCounts[role] > 1) throw Exception() << "more than one column has role " << role;
+	}
+	bool equatorial = roleCounts[INGEST_RA] || roleCounts[INGEST_DEC];
+	bool galactic = roleCounts[INGEST_LON] || roleCounts[INGEST_LAT];
+	if (equatorial == galactic) throw Exception() << "expected either ra and dec columns or lon and lat columns";
+	if (equatorial && !(roleCounts[INGEST_RA] && roleCounts[INGEST_DEC])) throw Exception() << "expected both ra and dec columns";
+	if (galactic && !(roleCounts[INGEST_LON] && roleCounts[INGEST_LAT])) throw Exception() << "expected both lon and lat columns";
+	if (!distance && !roleCounts[INGEST_REDSHIFT]) throw Exception() << "expected a redshift column or a distance function";
+}
+
+void IngestCounts::operator+=(IngestCounts const & o) {
+	numEntries += o.numEntries;
+	numReadable += o.numReadable;
+	if (numParsed.size() < o.numParsed.size()) numParsed.resize(o.numParsed.size());
+	for (size_t i = 0; i < o.numParsed.size(); i++) {
+		numParsed[i] += o.numParsed[i];
+	}
+}
+
+namespace {
+
+constexpr size_t blockSize = 64 << 20;	//read this much at a time
+constexpr size_t minChunkSize = 1 << 20;
+constexpr int chunksPerThread = 4;
+
+//one newline-aligned piece of a block, and what came of it, held until it's this chunk's turn to go to the sink
+struct IngestChunk {
+	const char *begin, *end;
+	IngestCounts counts;
+	std::vector<vec3f> pts;
+	std::vector<double> values;	//numColumns per point
+	std::vector<std::string> labels;	//numLabels per point
+	std::exception_ptr error;
+};
+
+//the spec, worked out for parsing
+struct IngestParser {
+	const IngestSpec &spec;
+	int numColumns;
+	std::vector<int> order;	//columns by field index, since the scanner only goes forward
+	std::vector<int> labelColumns;
+	int angle0, angle1;	//ra/dec or lon/lat
+	int redshift;
+
+	IngestParser(const IngestSpec &spec_) : spec(spec_), numColumns((int)spec_.columns.size()), angle0(-1), angle1(-1), redshift(-1) {
+		for (int c = 0; c < numColumns; c++) {
+			order.push_back(c);
+			switch (spec.columns[c].role) {
+			case INGEST_RA:
+			case INGEST_LON:
+				angle0 = c;
+				break;
+			case INGEST_DEC:
+			case INGEST_LAT:
+				angle1 = c;
+				break;
+			case INGEST_REDSHIFT:
+				redshift = c;
+				break;
+			case INGEST_LABEL:
+				labelColumns.push_back(c);
+				break;
+			default:
+				break;
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return spec.columns[a].index < spec.columns[b].index;
+		});
+	}
+
+	//verbose rows go straight to the sink as they're parsed, so its output follows the row's, rather than being held in the chunk
+	void parse(IngestChunk &chunk, const IngestSink *verboseSink = nullptr) const {
+		bool verbose = verboseSink != nullptr;
+		chunk.counts.numParsed.assign(numColumns, 0);
+		std::vector<double> values(numColumns);
+		std::vector<std::string_view> texts(numColumns);
+
+		for (const char *next = chunk.begin; next < chunk.end;) {
+			const char *line = next;
+			const char *eol = (const char*)std::memchr(line, '\n', chunk.end - line);
+			if (eol) {
+				next = eol + 1;
+			} else {
+				eol = next = chunk.end;
+			}
+			size_t len = eol - line;
+			if (len && line[len-1] == '\r') --len;
+			if (!len) continue;
+			if (spec.comment && line[0] == spec.comment) continue;
+			chunk.counts.numEntries++;
+
+			if (verbose) {
+				std::cout << "line " << std::string_view(line, len) << std::endl;
+			}
+
+			FieldScanner fields(line, len, spec.delim, spec.mergeDelims);
+			bool accept = true;
+			for (int c : order) {
+				const IngestColumn &col = spec.columns[c];
+				values[c] = NAN;
+				texts[c] = std::string_view();
+				if (!fields.seek(col.index)) {
+					if (col.required) {
+						accept = false;
+						break;
+					}
+					continue;
+				}
+				if (verbose) {
+					std::cout << col.name << ": " << fields.field() << std::endl;
+				}
+				if (col.type == INGEST_STRING) {
+					texts[c] = fields.field();
+				} else if (fields.parse(values[c])) {
+					chunk.counts.numParsed[c]++;
+				} else if (col.required) {
+					accept = false;
+					break;
+				}
+			}
+			if (!accept) continue;
+
+			double distance;
+			if (spec.distance) {
+				if (!spec.distance(values.data(), distance)) continue;
+			} else {
+				distance = values[redshift] / spec.hubbleConstant;
+			}
+
+			//angles are in degrees
+			double rad_ra = values[angle0] * M_PI / 180.0;
+			double rad_dec = values[angle1] * M_PI / 180.0;
+			double cos_dec = cos(rad_dec);
+			vec3f pt(
+				(float)(distance * cos(rad_ra) * cos_dec),
+				(float)(distance * sin(rad_ra) * cos_dec),
+				(float)(distance * sin(rad_dec)));
+
+			if (verbose) {
+				std::cout << "distance " << distance << " point " << pt << std::endl;
+			}
+
+			if (!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z)) continue;
+			chunk.counts.numReadable++;
+			if (verbose) {
+				std::vector<std::string> labels;
+				for (int c : labelColumns) {
+					labels.push_back(std::string(texts[c]));
+				}
+				(*verboseSink)(pt, values.data(), labels.empty() ? nullptr : labels.data());
+				continue;
+			}
+			chunk.pts.push_back(pt);
+			chunk.values.insert(chunk.values.end(), values.begin(), values.end());
+			for (int c : labelColumns) {
+				chunk.labels.push_back(std::string(texts[c]));
+			}
+		}
+	}
+};
+
+/*
+parses the chunks on numThreads threads, each taking the next chunk until they're gone.
+not a BatchProcessor, which profiles every arg, and there are numThreads * chunksPerThread chunks per block.
+*/
+void parseChunks(IngestParser const & parser, std::vector<IngestChunk> &chunks, int numThreads) {
+	std::atomic<size_t> nextChunk(0);
+	auto threadLoop = [&]() {
+		for (size_t i; (i = nextChunk++) < chunks.size();) {
+			//held for ingestFile to rethrow, since a chunk that quit early would silently drop rows
+			try {
+				parser.parse(chunks[i]);
+			} catch (...) {
+				chunks[i].error = std::current_exception();
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++) {
+		threads.emplace_back(threadLoop);
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+//past the next newline at or after p
+const char *nextLine(const char *p, const char *end) {
+	if (p >= end) return end;
+	const char *eol = (const char*)std::memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+}
+
+IngestCounts ingestFile(IngestSpec const & spec, std::string const & filename, IngestSink const & sink, int numThreads, bool verbose) {
+	spec.validate();
+	IngestParser parser(spec);
+
+	if (verbose) numThreads = 1;
+	if (numThreads <= 0) numThreads = std::max<int>(1, std::thread::hardware_concurrency());
+
+	IngestCounts counts;
+	counts.numParsed.assign(parser.numColumns, 0);
+
+	//block must end on a line end, or at the end of the file
+	auto ingestBlock = [&](const char *begin, const char *end) {
+		size_t chunkSize = std::max<size_t>(minChunkSize, (end - begin) / (numThreads * chunksPerThread) + 1);
+		std::vector<IngestChunk> chunks;
+		for (const char *p = begin; p < end;) {
+			IngestChunk chunk;
+			chunk.begin = p;
+			chunk.end = p = nextLine(p + std::min<size_t>(chunkSize, end - p) - 1, end);
+			chunks.push_back(std::move(chunk));
+		}
+
+		if (numThreads == 1 || chunks.size() == 1) {
+			for (auto &chunk : chunks) {
+				parser.parse(chunk, verbose ? &sink : nullptr);
+			}
+		} else {
+			parseChunks(parser, chunks, std::min<int>(numThreads, (int)chunks.size()));
+		}
+
+		for (auto const & chunk : chunks) {
+			if (chunk.error) std::rethrow_exception(chunk.error);
+			for (size_t i = 0; i < chunk.pts.size(); i++) {
+				sink(chunk.pts[i], chunk.values.data() + i * parser.numColumns, parser.labelColumns.empty() ? nullptr : chunk.labels.data() + i * parser.labelColumns.size());
+			}
+			counts += chunk.counts;
+		}
+	};
+
+	std::string base, ext;
+	getFileNameParts(filename, base, ext);
+	if (ext == "gz") {
+		//decompressing is serial, parsing each block is not
+		GZipReader src(filename);
+		std::vector<char> block(blockSize);
+		size_t carry = 0;	//partial line left from the last block
+		for (;;) {
+			size_t got = src.read(block.data() + carry, block.size() - carry);
+			size_t len = carry + got;
+			const char *data = block.data();
+			if (!got) {
+				ingestBlock(data, data + len);
+				break;
+			}
+			const char *last = data + len;
+			while (last > data && last[-1] != '\n') --last;
+			if (last == data) {
+				//one line bigger than the block
+				carry = len;
+				block.resize(block.size() * 2);
+				continue;
+			}
+			ingestBlock(data, last);
+			carry = data + len - last;
+			std::memmove(block.data(), last, carry);
+		}
+	} else {
+		MappedFile src(filename);
+		const char *data = (const char*)src.data();
+		const char *end = data + src.size();
+		for (const char *p = data; p < end;) {
+			const char *blockEnd = nextLine(p + std::min<size_t>(blockSize, end - p) - 1, end);
+			ingestBlock(p, blockEnd);
+			p = blockEnd;
+		}
+	}
+	return counts;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "vec.h"
+#include "defs.h"
+
+/*
+schema-driven text catalog ingestion, shared by the convert-* tools.
+a catalog is described by a delimiter and which columns hold what, instead of a strtok chain per survey.
+
+files are read in big blocks (.gz is decompressed as it's read, anything else is mapped),
+each block is cut into newline-aligned chunks, the chunks are parsed in parallel,
+and the accepted rows go to the sink in file order, so outputs match a serial read byte for byte.
+*/
+enum IngestColumnType {
+	INGEST_NUMBER,
+	INGEST_STRING,
+};
+
+enum IngestColumnRole {
+	INGEST_VALUE,	//no meaning of its own.  numbers are still handed to IngestSpec::distance and the sink
+	INGEST_RA,	//degrees.  ra/dec or lon/lat are the point's angles
+	INGEST_DEC,
+	INGEST_LON,	//galactic, degrees
+	INGEST_LAT,
+	INGEST_REDSHIFT,	//cz, km/s
+	INGEST_MAGNITUDE,
+	INGEST_LABEL,	//text kept with the point, for catalogs
+};
+
+struct IngestColumn {
+	int index;	//field #, from 0
+	IngestColumnType type;
+	IngestColumnRole role;
+	std::string name;
+	bool required;	//rows without it are dropped.  required numbers must also parse, the rest are NAN if they don't
+};
+
+struct IngestSpec {
+	char delim = '|';
+	bool mergeDelims = false;	//runs of delims are one, like strtok.  for space-aligned tables
+	char comment = 0;	//lines starting with this are skipped, as are empty lines
+	double hubbleConstant = HUBBLE_CONSTANT;	//for the default distance
+	std::vector<IngestColumn> columns;
+
+	//gets the row's numbers in column order, NAN where they didn't parse.  return false to drop the row.
+	//the default is redshift / hubbleConstant.
+	std::function<bool(const double *values, double &distance)> distance;
+
+	IngestSpec &column(int index, IngestColumnType type, IngestColumnRole role, std::string const & name, bool required = true) {
+		columns.push_back(IngestColumn{index, type, role, name, required});
+		return *this;
+	}
+
+	//throws if the columns don't make sense
+	void validate() const;
+};
+
+struct IngestCounts {
+	size_t numEntries = 0;	//lines that aren't comments or blank
+	size_t numReadable = 0;	//rows that made a finite point
+	std::vector<size_t> numParsed;	//per column, # of entries it parsed in
+
+	void operator+=(IngestCounts const & o);
+};
+
+//called for each accepted row, in file order.
+//values are the row's numbers in column order.  labels are the text of the INGEST_LABEL columns, in column order.
+typedef std::function<void(const vec3f &pt, const double *values, const std::string *labels)> IngestSink;
+
+//numThreads <= 0 uses the hardware concurrency.
+//verbose prints every row's columns and runs on one thread, handing each row to the sink right after printing it.
+IngestCounts ingestFile(IngestSpec const & spec, std::string const & filename, IngestSink const & sink, int numThreads, bool verbose = false);
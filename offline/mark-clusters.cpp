@@ -34,16 +34,25 @@ for 50k we can associate pointers with points ... but what about with 500m?
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <climits>
+#include <list>
+#include <memory>
 
 #include "octree.h"
 #include "defs.h"
 #include "util.h"
 #include "exception.h"
 #include "stat.h"
-
-struct Cluster {
-	std::vector<vec3f*> vtxs;
-};
+#include "fof.h"
+#include "skygrid.h"
+#include "clusters.h"
+#include "emst.h"
+
+//two doubles at a time in the batched merge tests.  every x86-64 has it
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
 
 
 //used by method #2 in the paper Angel cites
@@ -85,6 +94,21 @@ for b = (4/3 pi nBar_gal r_link^3)^1/3 = (4/3 pi nBar_gal)^1/3 r_link
 		return true;
 	}
 
+	//a pair at distances distA, distB, with unit vectors a chord apart, is linked if:
+	//the paper says (distA + distB) * sin(.5 * omega) 
+	//... and the limit as omega approaches zero becomes the arclength at the average distance:
+	//...which makes more sense to me, and seems to fail less often for my data
+	//the paper says fabs(distA + distB)
+	//..why would abs matter? it was in the originally cited paper (ref?) 
+	//..but most all subsequent papers just prune negative values
+	//so I just used fabs(distA - distB) ... where the fabs matters, and the difference is the radial distance
+	bool linked(double distA, double distB, double chordSq) const {
+		double distRadial = fabs(distA - distB);
+		double omega = 2. * asin(std::min(1., .5 * sqrt(chordSq)));	//same as acos(dot(unitA, unitB)), better near 0
+		double distTransverse = .5 * (distA + distB) * omega;
+		return distRadial < radialThreshold && distTransverse < transverseThreshold;
+	}
+
 	bool operator()(const vec3f &a, const vec3f &b) {
 		//radial distance in Mpc
 		double distA = a.len();	
@@ -93,22 +117,93 @@ for b = (4/3 pi nBar_gal r_link^3)^1/3 = (4/3 pi nBar_gal)^1/3 r_link
 		//double velA = distA * HUBBLE_CONSTANT / SPEED_OF_LIGHT;
 		//double velB = distB * HUBBLE_CONSTANT / SPEED_OF_LIGHT;
 		//redshift (z)
-		vec3d unitA = a * (1. / distA);
-		vec3d unitB = b * (1. / distB);
-		double cosOmega = vec3d::dot(unitA, unitB);
-		if (cosOmega < -1.) cosOmega = -1.;
-		if (cosOmega > 1.) cosOmega = 1.;
-		double omega = acos(cosOmega);
-		//the paper says (distA + distB) * sin(.5 * omega) 
-		//... and the limit as omega approaches zero becomes the arclength at the average distance:
-		//...which makes more sense to me, and seems to fail less often for my data
-		double distTransverse = .5 * (distA + distB) * omega; 
-		//the paper says fabs(distA + distB)
-		//..why would abs matter? it was in the originally cited paper (ref?) 
-		//..but most all subsequent papers just prune negative values
-		//so I just used fabs(distA - distB) ... where the fabs matters, and the difference is the radial distance
-		double distRadial = fabs(distA - distB);	
-		return distRadial < radialThreshold && distTransverse < transverseThreshold;
+		vec3d unitA = vec3d(a) * (1. / distA);
+		vec3d unitB = vec3d(b) * (1. / distB);
+		return linked(distA, distB, (unitA - unitB).lenSq());
+	}
+
+	//unit vectors and distances, in grid order
+	struct SoA {
+		std::vector<double> x, y, z, dist;
+	};
+
+	SoA prepare(const vec3f *vtxs, const std::vector<int> &order) const {
+		SoA soa;
+		size_t n = order.size();
+		soa.x.resize(n); soa.y.resize(n); soa.z.resize(n); soa.dist.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			const vec3f &v = vtxs[order[i]];
+			double dist = v.len();
+			soa.x[i] = v.x / dist;
+			soa.y[i] = v.y / dist;
+			soa.z[i] = v.z / dist;
+			soa.dist[i] = dist;
+		}
+		return soa;
+	}
+
+	//squared chord between unit vectors omega apart.  anything past pi is more than any chord (<= 4)
+	static double chordSqForAngle(double omega) {
+		if (omega >= M_PI) return 5.;
+		double s = sin(.5 * omega);
+		return 4. * s * s;
+	}
+
+	//bit k set if soa[i] links to soa[begin+k], count <= 64.
+	//distB is within radial of distA, so the arc limit 2 transverse / (distA + distB) on omega
+	//is between 2 transverse / (2 distA + radial) and 2 transverse / (2 distA - radial).
+	//chords inside the first pass, chords past the second fail, only the thin shell between needs the asin.
+	uint64_t testBatch(const SoA &soa, int i, int begin, int count) const {
+		const double ax = soa.x[i], ay = soa.y[i], az = soa.z[i], distA = soa.dist[i];
+		const double radialSq = radialThreshold * radialThreshold;
+		const double passSq = chordSqForAngle(2. * transverseThreshold / (2. * distA + radialThreshold));
+		const double failSq = 2. * distA > radialThreshold ? chordSqForAngle(2. * transverseThreshold / (2. * distA - radialThreshold)) : 5.;
+		const double *bx = soa.x.data() + begin, *by = soa.y.data() + begin, *bz = soa.z.data() + begin, *bd = soa.dist.data() + begin;
+		uint64_t pass = 0, maybe = 0;
+		int k = 0;
+#ifdef USE_SSE2
+		const __m128d ax2 = _mm_set1_pd(ax), ay2 = _mm_set1_pd(ay), az2 = _mm_set1_pd(az), distA2 = _mm_set1_pd(distA);
+		const __m128d radialSq2 = _mm_set1_pd(radialSq), passSq2 = _mm_set1_pd(passSq), failSq2 = _mm_set1_pd(failSq);
+		for (; k + 2 <= count; k += 2) {
+			__m128d dx = _mm_sub_pd(ax2, _mm_loadu_pd(bx + k));
+			__m128d dy = _mm_sub_pd(ay2, _mm_loadu_pd(by + k));
+			__m128d dz = _mm_sub_pd(az2, _mm_loadu_pd(bz + k));
+			__m128d dr = _mm_sub_pd(distA2, _mm_loadu_pd(bd + k));
+			__m128d c = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+			__m128d radial = _mm_cmplt_pd(_mm_mul_pd(dr, dr), radialSq2);
+			pass |= (uint64_t)_mm_movemask_pd(_mm_and_pd(radial, _mm_cmplt_pd(c, passSq2))) << k;
+			maybe |= (uint64_t)_mm_movemask_pd(_mm_and_pd(radial, _mm_cmplt_pd(c, failSq2))) << k;
+		}
+#endif
+		for (; k < count; ++k) {
+			double dr = distA - bd[k];
+			double c = chordSq(ax, ay, az, bx[k], by[k], bz[k]);
+			if (!(dr * dr < radialSq)) continue;
+			if (c < passSq) pass |= (uint64_t)1 << k;
+			if (c < failSq) maybe |= (uint64_t)1 << k;
+		}
+		maybe &= ~pass;
+		for (k = 0; maybe; ++k, maybe >>= 1) {
+			if ((maybe & 1) && linked(distA, bd[k], chordSq(ax, ay, az, bx[k], by[k], bz[k]))) pass |= (uint64_t)1 << k;
+		}
+		return pass;
+	}
+
+	static double chordSq(double ax, double ay, double az, double bx, double by, double bz) {
+		double dx = ax - bx, dy = ay - by, dz = az - bz;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	//upper bound on |a-b| for any pair that passes:
+	//|a-b|^2 = (distA-distB)^2 + 4 distA distB sin^2(omega/2) <= radial^2 + (.5 (distA+distB) omega)^2
+	double linkingLength() const {
+		return sqrt(radialThreshold * radialThreshold + transverseThreshold * transverseThreshold);
+	}
+
+	//neighbour index shaped like the linking region: radial shells crossed with sky cells
+	typedef SkyGrid Grid;
+	Grid makeGrid(const vec3f *vtxs, int numVtxs) const {
+		return SkyGrid(vtxs, numVtxs, radialThreshold, transverseThreshold);
 	}
 };
 
@@ -171,19 +266,280 @@ struct MergeTest_PowerSpectrumPaper {
 		//return dist <= threshold(avgDistBin);
 		return dist <= distanceThreshold;
 	}
+
+	//positions in grid order
+	struct SoA {
+		std::vector<double> x, y, z;
+	};
+
+	SoA prepare(const vec3f *vtxs, const std::vector<int> &order) const {
+		SoA soa;
+		size_t n = order.size();
+		soa.x.resize(n); soa.y.resize(n); soa.z.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			const vec3f &v = vtxs[order[i]];
+			soa.x[i] = v.x;
+			soa.y[i] = v.y;
+			soa.z[i] = v.z;
+		}
+		return soa;
+	}
+
+	//bit k set if soa[i] links to soa[begin+k], count <= 64.  doesn't accumulate the stats.
+	//with c the midpoint, radial = ab.c / |c| and transverse^2 = |ab|^2 - radial^2, so
+	//radial^2 / 100 + transverse^2 <= threshold^2 is |ab|^2 |c|^2 - .99 (ab.c)^2 <= threshold^2 |c|^2
+	//operator() fails a pair with its midpoint at the origin since normalizing c gives nans, so this checks |c|^2 > 0 to match
+	uint64_t testBatch(const SoA &soa, int i, int begin, int count) const {
+		const double ax = soa.x[i], ay = soa.y[i], az = soa.z[i];
+		const double thresholdSq = distanceThreshold * distanceThreshold;
+		const double *bx = soa.x.data() + begin, *by = soa.y.data() + begin, *bz = soa.z.data() + begin;
+		uint64_t pass = 0;
+		int k = 0;
+#ifdef USE_SSE2
+		const __m128d ax2 = _mm_set1_pd(ax), ay2 = _mm_set1_pd(ay), az2 = _mm_set1_pd(az);
+		const __m128d half = _mm_set1_pd(.5), f99 = _mm_set1_pd(.99), thresholdSq2 = _mm_set1_pd(thresholdSq), zero = _mm_setzero_pd();
+		for (; k + 2 <= count; k += 2) {
+			__m128d x = _mm_loadu_pd(bx + k), y = _mm_loadu_pd(by + k), z = _mm_loadu_pd(bz + k);
+			__m128d abx = _mm_sub_pd(x, ax2), aby = _mm_sub_pd(y, ay2), abz = _mm_sub_pd(z, az2);
+			__m128d cx = _mm_mul_pd(half, _mm_add_pd(ax2, x)), cy = _mm_mul_pd(half, _mm_add_pd(ay2, y)), cz = _mm_mul_pd(half, _mm_add_pd(az2, z));
+			__m128d abSq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(abx, abx), _mm_mul_pd(aby, aby)), _mm_mul_pd(abz, abz));
+			__m128d cSq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(cx, cx), _mm_mul_pd(cy, cy)), _mm_mul_pd(cz, cz));
+			__m128d abc = _mm_add_pd(_mm_add_pd(_mm_mul_pd(abx, cx), _mm_mul_pd(aby, cy)), _mm_mul_pd(abz, cz));
+			__m128d lhs = _mm_sub_pd(_mm_mul_pd(abSq, cSq), _mm_mul_pd(_mm_mul_pd(f99, abc), abc));
+			__m128d linked = _mm_and_pd(_mm_cmple_pd(lhs, _mm_mul_pd(thresholdSq2, cSq)), _mm_cmpgt_pd(cSq, zero));
+			pass |= (uint64_t)_mm_movemask_pd(linked) << k;
+		}
+#endif
+		for (; k < count; ++k) {
+			double abx = bx[k] - ax, aby = by[k] - ay, abz = bz[k] - az;
+			double cx = .5 * (ax + bx[k]), cy = .5 * (ay + by[k]), cz = .5 * (az + bz[k]);
+			double abSq = abx * abx + aby * aby + abz * abz;
+			double cSq = cx * cx + cy * cy + cz * cz;
+			double abc = abx * cx + aby * cy + abz * cz;
+			if (cSq > 0 && abSq * cSq - .99 * abc * abc <= thresholdSq * cSq) pass |= (uint64_t)1 << k;
+		}
+		return pass;
+	}
+
+	//radial <= 10 threshold and transverse <= threshold
+	double linkingLength() const {
+		return sqrt(101.) * distanceThreshold;
+	}
+
+	typedef CellGrid Grid;
+	Grid makeGrid(const vec3f *vtxs, int numVtxs) const {
+		return CellGrid(vtxs, numVtxs, linkingLength());
+	}
 };
 
 
 //MergeTest_PowerSpectrumPaper mergeTest;
 MergeTest_Angle mergeTest;
 
+/*
+out-of-core clustering over the octree leaves, for sets that don't fit in memory.
+pass 1: friends-of-friends within each leaf.  local labels go to octree/node<id>.clusters, next to the leaf's points.
+pass 2: for each pair of leaves within a linking length of each other, link points near the shared boundary.
+	leaf labels are numbered globally (leaf order, then local label) and joined in a sparse union-find,
+	which only ever holds the clusters that cross a leaf boundary.
+	only the current leaf and its neighbours are held, in an MRU cache bounded by point count.
+	the current leaf is pinned, so a small cache only re-reads neighbours, never the leaf they're being linked to.
+pass 3: rewrite the side files with final labels, numbered in order of first vertex (leaf order, then point order).
+no .links are written in this mode.
+*/
+struct OctreeLeaf {
+	OctreeNode *node;
+	int firstLabel;	//global label of the leaf's local label 0
+};
+
+struct LeafData {
+	std::vector<vec3f> vtxs;
+	std::vector<int> labels;
+};
+
+static std::vector<vec3f> readLeafPoints(std::string const & dir, OctreeNode *node) {
+	std::streamsize size = 0;
+	char *buffer = (char*)getFile(dir + node->getFileName(), &size);
+	std::vector<vec3f> vtxs((vec3f*)buffer, (vec3f*)buffer + size / sizeof(vec3f));
+	delete[] buffer;
+	return vtxs;
+}
+
+static std::vector<int> readLeafLabels(std::string const & dir, OctreeNode *node, size_t numVtxs) {
+	std::streamsize size = 0;
+	char *buffer = (char*)getFile(dir + node->getFileNameBase() + ".clusters", &size);
+	if ((size_t)size != numVtxs * sizeof(int)) {
+		delete[] buffer;
+		throw Exception() << node->getFileNameBase() << ".clusters doesn't match its point count";
+	}
+	std::vector<int> labels((int*)buffer, (int*)buffer + numVtxs);
+	delete[] buffer;
+	return labels;
+}
+
+struct LeafCache {
+	std::string dir;
+	size_t maxPoints, numPoints;
+	std::list<std::pair<OctreeNode*, std::shared_ptr<LeafData>>> queue;	//front is most recent
+	OctreeNode *pinned;	//never evicted
+
+	LeafCache(std::string const & dir_, size_t maxPoints_) : dir(dir_), maxPoints(maxPoints_), numPoints(0), pinned(nullptr) {}
+
+	//like get, but the leaf stays cached until another one is pinned, however many others are loaded meanwhile
+	std::shared_ptr<LeafData> pin(OctreeNode *node) {
+		pinned = node;
+		return get(node);
+	}
+
+	//the returned data stays valid while it's held, even if it's evicted
+	std::shared_ptr<LeafData> get(OctreeNode *node) {
+		for (auto i = queue.begin(); i != queue.end(); ++i) {
+			if (i->first == node) {
+				queue.splice(queue.begin(), queue, i);
+				return queue.front().second;
+			}
+		}
+		std::shared_ptr<LeafData> data = std::make_shared<LeafData>();
+		data->vtxs = readLeafPoints(dir, node);
+		data->labels = readLeafLabels(dir, node, data->vtxs.size());
+		numPoints += data->vtxs.size();
+		queue.push_front(std::make_pair(node, data));
+		//least recent first, skipping the pinned leaf and the one just loaded
+		for (auto i = std::prev(queue.end()); numPoints > maxPoints && i != queue.begin();) {
+			auto prev = std::prev(i);
+			if (i->first != pinned) {
+				numPoints -= i->second->vtxs.size();
+				queue.erase(i);
+			}
+			i = prev;
+		}
+		return data;
+	}
+};
+
+static box3f expandBox(const box3f &b, float r) {
+	return box3f(b.min - vec3f(r), b.max + vec3f(r));
+}
+
+static bool boxesTouch(const box3f &a, const box3f &b) {
+	for (int k = 0; k < 3; ++k) {
+		if (a.min[k] > b.max[k] || b.min[k] > a.max[k]) return false;
+	}
+	return true;
+}
+
+static void clusterOctree(std::string const & datasetname, int numThreads, size_t cacheSize) {
+	std::string dir = std::string() + "datasets/" + datasetname + "/";
+	std::unique_ptr<OctreeNode> root(OctreeNode::readSet(datasetname));
+	double linkingLength = mergeTest.linkingLength();
+	float reach = (float)linkingLength;
+
+	std::vector<OctreeLeaf> leaves;
+	std::function<void(OctreeNode*)> collect = [&](OctreeNode *node) {
+		if (node->leaf) {
+			if (node->numPoints) leaves.push_back(OctreeLeaf{node, 0});
+			return;
+		}
+		for (int i = 0; i < numberof(node->ch); ++i) {
+			if (node->ch[i]) collect(node->ch[i]);
+		}
+	};
+	collect(root.get());
+	std::cout << leaves.size() << " leaves" << std::endl;
+
+	long numLabels = 0;
+	profile("leaf clustering", [&](){
+		for (OctreeLeaf &leaf : leaves) {
+			std::vector<vec3f> vtxs = readLeafPoints(dir, leaf.node);
+			int n = (int)vtxs.size();
+			UnionFind sets(n);
+			std::vector<vec2i> links;
+			decltype(mergeTest)::Grid grid = mergeTest.makeGrid(vtxs.data(), n);
+			FoFBatchProcessor<decltype(mergeTest), decltype(grid)> batch(vtxs.data(), grid, mergeTest);
+			if (numThreads > 0) batch.setNumThreads(numThreads);
+			batch.run(sets, links);
+
+			std::vector<int> labels(n);
+			int numLeafLabels = sets.labels(labels.data());
+			leaf.firstLabel = (int)numLabels;
+			numLabels += numLeafLabels;
+			if (numLabels > INT_MAX) throw Exception() << "too many clusters for int labels";
+			writeFile(dir + leaf.node->getFileNameBase() + ".clusters", labels.data(), n * sizeof(int));
+		}
+	});
+
+	SparseUnionFind joined;
+	profile("boundary linking", [&](){
+		LeafCache cache(dir, cacheSize);
+		for (int i = 0; i < (int)leaves.size(); ++i) {
+			const OctreeLeaf &la = leaves[i];
+			box3f reachA = expandBox(la.node->bbox, reach);
+			//loaded at its first neighbour, and pinned so its neighbours can't push it out
+			std::shared_ptr<LeafData> a;
+			for (int j = i + 1; j < (int)leaves.size(); ++j) {
+				const OctreeLeaf &lb = leaves[j];
+				if (!boxesTouch(reachA, lb.node->bbox)) continue;
+				if (!a) a = cache.pin(la.node);
+				std::shared_ptr<LeafData> b = cache.get(lb.node);
+
+				//b's points within reach of a
+				std::vector<vec3f> near;
+				std::vector<int> nearIndex;
+				for (int k = 0; k < (int)b->vtxs.size(); ++k) {
+					if (!OctreeNode::contains(reachA, b->vtxs[k])) continue;
+					near.push_back(b->vtxs[k]);
+					nearIndex.push_back(k);
+				}
+				if (near.empty()) continue;
+				CellGrid grid(near.data(), (int)near.size(), linkingLength);
+
+				box3f reachB = expandBox(lb.node->bbox, reach);
+				for (int k = 0; k < (int)a->vtxs.size(); ++k) {
+					const vec3f &v = a->vtxs[k];
+					if (!OctreeNode::contains(reachB, v)) continue;
+					int labelA = la.firstLabel + a->labels[k];
+					grid.forEachNeighbor(v, [&](int m) {
+						int labelB = lb.firstLabel + b->labels[nearIndex[m]];
+						if (joined.find(labelA) == joined.find(labelB)) return;
+						if (mergeTest(v, near[m])) joined.merge(labelA, labelB);
+					});
+				}
+			}
+		}
+	});
+
+	//final label = root label minus the # of merged-away labels before it
+	std::vector<int> mergedAway;
+	for (const std::pair<const int, int> &p : joined.parent) {
+		if (p.first != p.second) mergedAway.push_back(p.first);
+	}
+	std::sort(mergedAway.begin(), mergedAway.end());
+	std::cout << "made " << (numLabels - (long)mergedAway.size()) << " clusters, "
+		<< mergedAway.size() << " leaf clusters were joined across leaves" << std::endl;
+
+	profile("relabeling", [&](){
+		for (const OctreeLeaf &leaf : leaves) {
+			std::vector<int> labels = readLeafLabels(dir, leaf.node, leaf.node->numPoints);
+			for (int &l : labels) {
+				int root = joined.find(leaf.firstLabel + l);
+				l = root - (int)(std::lower_bound(mergedAway.begin(), mergedAway.end(), root) - mergedAway.begin());
+			}
+			writeFile(dir + leaf.node->getFileNameBase() + ".clusters", labels.data(), labels.size() * sizeof(int));
+		}
+	});
+}
+
 void _main(std::vector<std::string> const & args) {
 	// TODO standardize the set / file / dir picker
 	std::string datasetname = "allsky";
-	std::streamsize maxVtxs = 0;
 
 	bool dontWrite = false;
 	bool outputRadialDistribution = false;
+	int numThreads = 0;
+	bool octree = false;
+	bool emst = false;
+	double cutLength = -1;
+	long cacheSize = 8 * OctreeNode::splitThreshold;
 	HandleArgs(args, {
 		{"--set", {"<set> = specify the dataset. default is 'allsky'.", {[&](std::string s){
 			datasetname = s;
@@ -194,8 +550,20 @@ void _main(std::vector<std::string> const & args) {
 		{"--dont-write", {"= don't write points back out, just print # clusters.", {[&](){
 			dontWrite = true;
 		}}}},
-		{"--max", {"<v> = max vertexes to process.", {std::function<void(int)>([&](int n){
-			maxVtxs = n;
+		{"--threads", {"<n> = number of threads.  default is the hardware concurrency.  the output doesn't depend on it.", {std::function<void(int)>([&](int n){
+			numThreads = n;
+		})}}},
+		{"--emst", {"= compute the euclidean minimum spanning tree and write it to <file>.emst.", {[&](){
+			emst = true;
+		}}}},
+		{"--cut", {"<length> = cluster by cutting the .emst at this isotropic linking length, instead of using the merge test.", {std::function<void(double)>([&](double x){
+			cutLength = x;
+		})}}},
+		{"--octree", {"= cluster the octree leaves out-of-core.  labels go to octree/node*.clusters.", {[&](){
+			octree = true;
+		}}}},
+		{"--cache", {"<n> = with --octree, max # of points to keep loaded.  default is 8 leaves' worth.", {std::function<void(int)>([&](int n){
+			cacheSize = n;
 		})}}},
 #if 0
 		{"--file", {"<file>	convert only this file. omit path and ext.", {[&](std::string s){
@@ -219,6 +587,11 @@ void _main(std::vector<std::string> const & args) {
 #endif		
 	});
 
+	if (octree) {
+		clusterOctree(datasetname, numThreads, cacheSize);
+		return;
+	}
+
 #if 1	//single file / buffer all points at once
 	//util.cpp me plz
 	std::list<std::string> filenames;
@@ -278,90 +651,52 @@ void _main(std::vector<std::string> const & args) {
 	//do the clustering
 
 	Stat redshift;
-	std::vector<Cluster*> clusters;
 	for (vec3f *v = vtxs; v < vtxs + numVtxs; v++) {
-		Cluster *c = new Cluster();
-		c->vtxs.push_back(v);
-		clusters.push_back(c);
 		//while we're here, accum on the length of the vertex 
 		redshift.accum(v->len() * HUBBLE_CONSTANT / SPEED_OF_LIGHT, (double)(v - vtxs) + 1);
 	}
 	redshift.calcStdDev();	
 	std::cout << redshift.rw("redshift") << std::endl;
 
-	std::vector<vec2i> links;
-
-	printf("processing     ");
-	for (int ica = 0; ica < clusters.size()-1; ica++) {
-		if (maxVtxs > 0 && ica >= maxVtxs) break;
-		double frac = (double)ica / (double)(clusters.size()-2);
-		int percent = (int)(100. * sqrt(frac));
-		printf("\b\b\b\b%3d%%", percent);
-
-		Cluster *ca = clusters[ica];
-	//for (std::vector<Cluster*>::iterator cai = clusters.begin(); cai != clusters.end(); ++cai) {
-	//	Cluster *ca = *cai;
-		
-		//use a for-loop so it doesn't get invalidated
-		for (int iva = 0; iva < ca->vtxs.size(); iva++) {
-			vec3f *va = ca->vtxs[iva];
-		//for (std::vector<vec3f*>::iterator vai = ca->vtxs.begin(); vai != ca->vtxs.end(); ++vai) {
-		//	vec3f *va = *vai;
-	
-			for (int icb = ica+1; icb < clusters.size(); icb++) {
-				if (maxVtxs > 0 && icb >= maxVtxs) break;
-				Cluster *cb = clusters[icb];
-			//for (std::vector<Cluster*>::iterator cbi = cai+1; cbi != clusters.end();) {
-			//	Cluster *cb = *cbi;
-			
-				int mergeDest = -1;
-				for (std::vector<vec3f*>::iterator vbi = cb->vtxs.begin(); vbi != cb->vtxs.end(); ++vbi) {
-					vec3f *vb = *vbi;
-					
-					if (mergeTest(*va, *vb)) {
-						mergeDest = vb - vtxs;
-						//break; //if you don't want to see the best candidate
-					}
-				}
-
-				if (mergeDest != -1) {
-					links.push_back(vec2i((int)(va - vtxs), mergeDest));
-					
-					//then merge all points in ca and cb
-					ca->vtxs.insert(ca->vtxs.end(), cb->vtxs.begin(), cb->vtxs.end());
-					/*
-					for (std::vector<vec3f*>::iterator v = cb->vtxs.begin(); v != cb->vtxs.end(); ++v) {
-						ca->vtxs.push_back(*v);
-					}
-					*/
-					//inserting could invalidate ca->vtxs (since it is a std::vector)
-					
-					//and stop testing this chunk
-					//let our loop know not to increment cbi
-			
-					clusters.erase(clusters.begin() + icb);
-				} else {
-					icb++;
-				}
-			}
+	std::string base, ext;
+	getFileNameParts(*filenames.begin(), base, ext);
+	std::string emstFilename = std::string() + "datasets/" + datasetname + "/points/" + base + ".emst";
+	std::vector<EmstEdge> edges;
+	if (emst) {
+		profile("emst", [&](){
+			edges = computeEMST(vtxs, numVtxs, numThreads);
+		});
+		writeEMST(emstFilename, numVtxs, edges);
+		if (!edges.empty()) std::cout << "longest emst edge is " << sqrt(edges.back().lengthSq) << std::endl;
+		if (cutLength < 0) {
+			delete[] (unsigned char *)vtxs;
+			return;
 		}
 	}
-	printf("\n");
-
-	//std::cout << radialDifference.rw("radialDifference") << transverseDifference.rw("transverseDistance") << std::endl;
-
-	std::cout << "made " << clusters.size() << " clusters" << std::endl;
 
+	//cluster indexes are ordered by their first vertex
 	typedef int clusterIndex_t;	//just don't exceed 2b clusters 
 	int *vtxClusters = new int[numVtxs];
-	std::memset(vtxClusters, -1, sizeof(int) * numVtxs);
-	for (int clusterIndex = 0; clusterIndex < clusters.size(); ++clusterIndex) {
-		Cluster *cluster = clusters[clusterIndex];
-		for (std::vector<vec3f*>::iterator vi = cluster->vtxs.begin(); vi != cluster->vtxs.end(); ++vi) {
-			int vtxIndex = (*vi) - vtxs;
-			vtxClusters[vtxIndex] = clusterIndex;
-		}
+	int numClusters = 0;
+	std::vector<vec2i> links;
+	if (cutLength >= 0) {
+		if (!emst) edges = readEMST(emstFilename, numVtxs);
+		numClusters = cutEMST(edges, numVtxs, cutLength, vtxClusters, links);
+	} else {
+		UnionFind sets(numVtxs);
+		profile("friends-of-friends", [&](){
+			decltype(mergeTest)::Grid grid = mergeTest.makeGrid(vtxs, numVtxs);
+			std::cout << grid.cells.size() << " occupied cells" << std::endl;
+			FoFBatchProcessor<decltype(mergeTest), decltype(grid)> batch(vtxs, grid, mergeTest);
+			if (numThreads > 0) batch.setNumThreads(numThreads);
+			batch.run(sets, links);
+		});
+		numClusters = sets.labels(vtxClusters);
 	}
+
+	//std::cout << radialDifference.rw("radialDifference") << transverseDifference.rw("transverseDistance") << std::endl;
+
+	std::cout << "made " << numClusters << " clusters" << std::endl;
 	
 	std::map<int, int> clusterSizes;
 	for (int i = 0; i < numVtxs; i++) {
@@ -377,48 +712,18 @@ void _main(std::vector<std::string> const & args) {
 	}
 	std::cout << singleClusters << " individual clusters" << std::endl;
 	
-	{
-		std::string base, ext;
-		getFileNameParts(*filenames.begin(), base, ext);
+	if (!dontWrite) {
 		std::string clusterFilename = std::string() + "datasets/" + datasetname + "/points/" + base + ".clusters";
 		writeFile(clusterFilename, vtxClusters, numVtxs * sizeof(int));
 		std::string linkFilename = std::string() + "datasets/" + datasetname + "/points/" + base + ".links";
-		writeFile(linkFilename, &links[0], links.size() * sizeof(vec2i));
+		writeFile(linkFilename, links.data(), links.size() * sizeof(vec2i));
+		std::string catalogFilename = std::string() + "datasets/" + datasetname + "/points/" + base + ".csr";
+		writeClusterCatalog(catalogFilename, vtxs, vtxClusters, numVtxs, numClusters);
 	}
 
-	clusters.clear();	
+	delete[] vtxClusters;
 	delete[] (unsigned char *)vtxs;
 #endif
-
-#if 0	//TODO octree, unless you can fit all 500m points (and clusters) in memory
-	OctreeNode *root = OctreeNode::readSet(datasetname);
-
-	struct CompareIterator {
-		vec3f v;
-		CompareIterator(const vec3f &v_) : v(v_) {}
-		void operator()(OctreeNoe *n) {
-			vec3f *vtxs = getFile(n->getFileName());
-			vec3f *vtxEnd = vtxs + numPoints;
-			for (vec3f *w = vtxs; w < vtxEnd; w++) {
-				testMerge(*v, *w);
-			}
-			delete[] vtxs;
-		}
-	};
-
-	struct NodeIterator {
-		void operator()(OctreeNode *n) {
-			vec3f *vtxs = getFile(n->getFileName());
-			vec3f *vtxEnd = vtxs + numPoints;
-			for (vec3f *v = vtxs; v < vtxEnd; v++) {
-				n->recurse<CompareIterator>(CompareIterator(*v));
-			}
-			delete[] vtxs;
-		}
-	};
-
-	root->recurse<NodeIterator>(NodeIterator());
-#endif
 }
 
 int main(int argc, char **argv) {
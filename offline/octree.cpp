@@ -71,6 +71,21 @@ bool OctreeNode::contains(const box3f &b, const vec3f &v) {
 		&& b.min.z <= v.z;
 }
 
+OctreeNode *OctreeNode::findLeaf(const vec3f &v) {
+	if (!contains(bbox, v)) return nullptr;
+	OctreeNode *node = this;
+	while (!node->leaf) {
+		//same as genoctree: +axis children are >, -axis children are <=
+		vec3f center = node->bbox.center();
+		int childIndex = (v.x > center.x) |
+				((v.y > center.y) << 1) |
+				((v.z > center.z) << 2);
+		node = node->ch[childIndex];
+		if (!node) return nullptr;
+	}
+	return node;
+}
+
 #include <list>
 #include <algorithm>
 #include "util.h"	//getFileNameParts
@@ -93,43 +108,39 @@ OctreeNode *OctreeNode::readSet(const std::string &datasetname) {
 	//sort by name
 	files.sort();
 	//int numNodesWithPoints = 0;	
-	OctreeNode *root = nullptr;
-	//last i checked stl sort grouped by length then sorted alphabetically  -- just what i'm looking for
+
+	//only leaves have files, and node.f32 is gone once the root splits, so make the root up front
+	//same bbox genoctree uses
+	StatSet totalStats;
+	totalStats.read((std::string("datasets/") + datasetname + "/stats/total.stats").c_str());
+	box3f bbox;
+	for (int j = 0; j < 3; j++) {
+		bbox.min[j] = totalStats.vars()[STATSET_X+j].min;
+		bbox.max[j] = totalStats.vars()[STATSET_X+j].max;
+	}
+	OctreeNode *root = new OctreeNode(nullptr, -1, bbox.min, bbox.max);
+
+	//sorted, so parents come before their children
 	for (auto const & filename : files) {
 		//pick out suffix: "node<suffix>.f32"
 		//use it to determine node order
 		std::string ident = filename.substr(4, filename.length()-8);
 		//cout << "loading ident " << ident << endl;
 		int identLength = ident.length();
-		if (!identLength) {
-			if (root) throw Exception() << "found two roots";
-			
-			StatSet totalStats;
-			totalStats.read((std::string("datasets/") + datasetname + "/stats/total.stats").c_str());
-			box3f bbox;
-			for (int j = 0; j < 3; j++) {
-				bbox.min[j] = totalStats.vars()[STATSET_X+j].min;
-				bbox.max[j] = totalStats.vars()[STATSET_X+j].max;
-			}
-			root = new OctreeNode(nullptr, -1, bbox.min, bbox.max);
-		
-			//numNodesWithPoints++;
-		} else {
-			OctreeNode *node = root;
-			for (int j = 0; j < identLength; j++) {
-				int childIndex = ident[j] - 'a';
-				assert(childIndex >= 0 && childIndex < 8);
-				if (!node->ch[childIndex]) {
-					node->leaf = false;
-					node->ch[childIndex] = new OctreeNode(node, childIndex);
-				}
-				node = node->ch[childIndex];
+		OctreeNode *node = root;
+		for (int j = 0; j < identLength; j++) {
+			int childIndex = ident[j] - 'a';
+			if (childIndex < 0 || childIndex >= 8) throw Exception() << "bad octree node file name " << filename;
+			if (!node->ch[childIndex]) {
+				node->leaf = false;
+				node->ch[childIndex] = new OctreeNode(node, childIndex);
 			}
-			//now read the points into 'node'
-			node->numPoints = getFileSize(node->getFileName()) / sizeof(vec3f);
-
-			//numNodesWithPoints++;
+			node = node->ch[childIndex];
 		}
+		//getFileName() is relative to the dataset dir
+		node->numPoints = getFileSize(std::string("datasets/") + datasetname + "/" + node->getFileName()) / sizeof(vec3f);
+
+		//numNodesWithPoints++;
 	}
 	//cout << "numNodesWithPoints " << numNodesWithPoints << endl;	
 	return root;
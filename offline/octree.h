@@ -27,6 +27,9 @@ struct OctreeNode {
 	virtual std::string getFileName();	
 	static bool contains(const box3f &b, const vec3f &v);
 
+	//the leaf under this node that genoctree would have put v in, or null if there's no such leaf
+	OctreeNode *findLeaf(const vec3f &v);
+
 	static OctreeNode *readSet(const std::string &setname);
 };
 
@@ -19,6 +19,7 @@
 #include "util.h"
 #include "stat.h"
 #include "octree.h"
+#include "clusters.h"
 #include "mrucache.h"
 
 using namespace std;
@@ -264,7 +265,7 @@ struct RenderSimplePointSet {
 	streamsize numVtxs, numLinks;
 	vec3f *vtxs;
 	vec2i *links;
-	int *clusters;
+	int *colors;	//per vertex, from its cluster
 	bool visible;
 
 	RenderSimplePointSet(RenderSimple &renderSimple_, const string &filename);
@@ -379,48 +380,39 @@ RenderSimplePointSet::RenderSimplePointSet(RenderSimple &renderSimple_, const st
 	numLinks(0),
 	vtxs(nullptr),
 	links(nullptr),
-	clusters(nullptr),
+	colors(nullptr),
 	visible(true)
 {
 	vtxs = (vec3f*)getFile(filename, &numVtxs);
 	numVtxs /= sizeof(vec3f);
-	streamsize clusterFileSize = 0;
-	clusters = (int*)getFile(filename.substr(0, filename.length()-3)+"clusters", &clusterFileSize);
-	assert(clusterFileSize / sizeof(int) == numVtxs);
 	numLinks = 0;
 	links = (vec2i*)getFile(filename.substr(0, filename.length()-3)+"links", &numLinks);
 	numLinks /= sizeof(vec2i);	
-	
-	for (int i = 0; i < numVtxs-1; i++) {
-		int j = i+1;
-		for (; j < numVtxs; j++) {
-			if (clusters[i] == clusters[j]) {
-				break;
-			}
-		}
-		if (j == numVtxs) {
-			clusters[i] = -1;
-		}
-	}
+
+	ClusterCatalog catalog(filename.substr(0, filename.length()-3)+"csr");
+	assert(catalog.numMembers() == numVtxs);
+	colors = new int[numVtxs];
 
 	//pick some random numbers...
-	for (int i = 0; i < numVtxs; i++) {
-		if (clusters[i] == -1) {
-			clusters[i] = 0xff7f7f7f;
-		} else {
-			srand(clusters[i]);
+	for (int c = 0; c < catalog.numClusters(); c++) {
+		int color = 0xff7f7f7f;	//singletons are grey
+		if (catalog.summary(c).size > 1) {
+			srand(c);
 			rand();
 			rand();
 			rand();
 			vec3f v(frand(), frand(), frand());
 			float l = v.len();
 			if (l < 1) v /= l;
-			clusters[i] =
+			color =
 				(int)(v.x * 255.f) |
 				((int)(v.y * 255.f) << 8) |
 				((int)(v.z * 255.f) << 16) |
 				0xff000000;
 		}
+		for (const uint32_t *m = catalog.begin(c); m < catalog.end(c); ++m) {
+			colors[*m] = color;
+		}
 	}
 
 }
@@ -428,14 +420,14 @@ RenderSimplePointSet::RenderSimplePointSet(RenderSimple &renderSimple_, const st
 RenderSimplePointSet::~RenderSimplePointSet() {
 	delete[] (char*)vtxs;
 	delete[] (char*)links;
-	delete[] (char*)clusters;
+	delete[] colors;
 }
 
 void RenderSimplePointSet::draw() {
 	if (!visible) return;
 
 	glVertexPointer(3, GL_FLOAT, 0, vtxs);
-	glColorPointer(4, GL_UNSIGNED_BYTE, 0, clusters);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, colors);
 
 	glEnableClientState(GL_COLOR_ARRAY);
 
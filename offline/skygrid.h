@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "fof.h"
+
+/*
+neighbour grid in (radial shell, sky cell) coordinates, for merge tests with separate radial and transverse limits.
+shells are radialWidth thick, so a pair closer than that radially is in the same or adjacent shells.
+each shell cuts the sky into igloo-style equal-area cells: bands of equal height in colatitude,
+each band split in longitude into as many cells as its area allows.
+a shell's cells are about as wide as the linking angle at that shell's radius, transverse / radius,
+so the cells follow the elongated line-of-sight linking region instead of a cartesian cube around it.
+
+a pair at distances dA, dB and angle omega passes only if .5 (dA + dB) omega < transverse,
+so within shells sA, sB, omega < 2 transverse / (inner radius A + inner radius B).
+two cells are neighbours when their centers are within that angle plus both cells' radii.
+that is symmetric, so each pair is visited once from the cell with the smaller index.
+*/
+struct SkyGrid : public SortedCells {
+	static constexpr int blockShells = 4;	//shells per block
+	static constexpr int bandBits = 21, phiBits = 21;
+	static constexpr double minCellAngle = 1e-5;	//keeps band and phi counts in their bits
+
+	struct Shell {
+		double cellAngle;
+		double bandHeight;
+		std::vector<int> numPhi;	//per band
+		double maxRadius;	//largest cell radius in this shell
+	};
+
+	double radialWidth, transverse;
+	std::vector<Shell> shells;
+
+	static uint64_t key(int shell, int band, int phi) {
+		return ((uint64_t)shell << (bandBits + phiBits)) | ((uint64_t)band << phiBits) | (uint64_t)phi;
+	}
+	static int keyShell(uint64_t key) { return (int)(key >> (bandBits + phiBits)); }
+	static int keyBand(uint64_t key) { return (int)((key >> phiBits) & ((1 << bandBits) - 1)); }
+	static int keyPhi(uint64_t key) { return (int)(key & ((1 << phiBits) - 1)); }
+
+	double innerRadius(int shell) const { return radialWidth * shell; }
+
+	//upper bound on the angle between two linked points in these shells
+	double linkAngle(int shellA, int shellB) const {
+		double r = innerRadius(shellA) + innerRadius(shellB);
+		return r > 0 ? std::min(M_PI, 2. * transverse / r) : M_PI;
+	}
+
+	void makeShell(Shell &shell, int index) {
+		shell.cellAngle = std::max(minCellAngle, std::min(M_PI, linkAngle(index, index)));
+		int numBands = (int)ceil(M_PI / shell.cellAngle);
+		shell.bandHeight = M_PI / numBands;
+		shell.numPhi.resize(numBands);
+		shell.maxRadius = 0;
+		for (int b = 0; b < numBands; ++b) {
+			double theta0 = b * shell.bandHeight;
+			double theta1 = theta0 + shell.bandHeight;
+			double area = 2. * M_PI * (cos(theta0) - cos(theta1));
+			shell.numPhi[b] = std::max(1, (int)floor(area / (shell.cellAngle * shell.cellAngle) + .5));
+			shell.maxRadius = std::max(shell.maxRadius, cellRadius(shell, b));
+		}
+	}
+
+	//half the band height plus half the widest longitude arc.  every point of the cell is within this of its center.
+	static double cellRadius(const Shell &shell, int band) {
+		double theta0 = band * shell.bandHeight;
+		double theta1 = theta0 + shell.bandHeight;
+		double sinMax = theta0 <= .5 * M_PI && theta1 >= .5 * M_PI ? 1. : std::max(sin(theta0), sin(theta1));
+		return std::min(M_PI, .5 * shell.bandHeight + M_PI / shell.numPhi[band] * sinMax);
+	}
+
+	void cellCenter(uint64_t k, double &theta, double &phi) const {
+		const Shell &shell = shells[keyShell(k)];
+		int band = keyBand(k);
+		theta = (band + .5) * shell.bandHeight;
+		phi = (keyPhi(k) + .5) * 2. * M_PI / shell.numPhi[band];
+	}
+
+	static double angleBetween(double thetaA, double phiA, double thetaB, double phiB) {
+		double c = cos(thetaA) * cos(thetaB) + sin(thetaA) * sin(thetaB) * cos(phiA - phiB);
+		return acos(std::max(-1., std::min(1., c)));
+	}
+
+	int block(int cell) const {
+		return keyShell(cells[cell].key) / blockShells;
+	}
+
+	template<typename F>
+	void forEachForwardNeighbor(int cell, F f) const {
+		uint64_t keyA = cells[cell].key;
+		int shellA = keyShell(keyA);
+		double thetaA, phiA;
+		cellCenter(keyA, thetaA, phiA);
+		double radiusA = cellRadius(shells[shellA], keyBand(keyA));
+
+		for (int shellB = shellA; shellB <= shellA + 1 && shellB < (int)shells.size(); ++shellB) {
+			const Shell &shell = shells[shellB];
+			double link = linkAngle(shellA, shellB);
+			double reach = radiusA + shell.maxRadius + link;
+			int numBands = (int)shell.numPhi.size();
+			int band0 = std::max(0, (int)floor((thetaA - reach) / shell.bandHeight));
+			int band1 = std::min(numBands - 1, (int)floor((thetaA + reach) / shell.bandHeight));
+			bool allPhi = thetaA - reach <= 0 || thetaA + reach >= M_PI || sin(reach) >= sin(thetaA);
+			double halfWidth = allPhi ? M_PI : asin(sin(reach) / sin(thetaA));
+			for (int band = band0; band <= band1; ++band) {
+				int numPhi = shell.numPhi[band];
+				double phiSize = 2. * M_PI / numPhi;
+				int phi0 = (int)floor((phiA - halfWidth) / phiSize);
+				int phi1 = (int)floor((phiA + halfWidth) / phiSize);
+				if (allPhi || phi1 - phi0 + 1 >= numPhi) {
+					phi0 = 0;
+					phi1 = numPhi - 1;
+				}
+				double limit = radiusA + cellRadius(shell, band) + link;
+				auto visit = [&](int p0, int p1) {
+					//the band's occupied cells in [p0,p1] are contiguous in key order
+					auto i = std::lower_bound(cells.begin(), cells.end(), key(shellB, band, p0), [](const Cell &c, uint64_t k) { return c.key < k; });
+					uint64_t lastKey = key(shellB, band, p1);
+					for (; i != cells.end() && i->key <= lastKey; ++i) {
+						int neighbor = (int)(i - cells.begin());
+						if (neighbor <= cell) continue;
+						double thetaB, phiB;
+						cellCenter(i->key, thetaB, phiB);
+						if (angleBetween(thetaA, phiA, thetaB, phiB) <= limit) f(neighbor);
+					}
+				};
+				if (phi0 < 0) {
+					visit(phi0 + numPhi, numPhi - 1);
+					visit(0, phi1);
+				} else if (phi1 >= numPhi) {
+					visit(phi0, numPhi - 1);
+					visit(0, phi1 - numPhi);
+				} else {
+					visit(phi0, phi1);
+				}
+			}
+		}
+	}
+
+	SkyGrid(const vec3f *vtxs, int numVtxs, double radialWidth_, double transverse_)
+	: radialWidth(radialWidth_), transverse(transverse_) {
+		if (!(radialWidth > 0) || !(transverse > 0)) throw Exception() << "sky grid needs positive radial and transverse widths";
+		double maxDist = 0;
+		for (const vec3f *v = vtxs; v < vtxs + numVtxs; ++v) {
+			maxDist = std::max<double>(maxDist, v->len());
+		}
+		int numShells = (int)floor(maxDist / radialWidth) + 1;
+		if (numShells >= (1 << (64 - bandBits - phiBits))) throw Exception() << "radial width " << radialWidth << " is too small for this data";
+		shells.resize(numShells);
+		for (int s = 0; s < numShells; ++s) {
+			makeShell(shells[s], s);
+		}
+
+		std::vector<std::pair<uint64_t, int>> keys(numVtxs);
+		for (int i = 0; i < numVtxs; ++i) {
+			const vec3f &v = vtxs[i];
+			double dist = v.len();
+			int s = std::min(numShells - 1, (int)floor(dist / radialWidth));
+			const Shell &shell = shells[s];
+			double theta = dist > 0 ? acos(std::max(-1., std::min(1., v.z / dist))) : 0.;
+			double phi = atan2((double)v.y, (double)v.x);
+			if (phi < 0) phi += 2. * M_PI;
+			int numBands = (int)shell.numPhi.size();
+			int band = std::min(numBands - 1, (int)(theta / shell.bandHeight));
+			int numPhi = shell.numPhi[band];
+			int p = std::min(numPhi - 1, (int)(phi / (2. * M_PI) * numPhi));
+			keys[i] = std::make_pair(key(s, band, p), i);
+		}
+		build(keys);
+	}
+};
@@ -1,6 +1,7 @@
 #include <fstream>
 #include <map>
 #include <cassert>
+#include <cstring>	//std::memcmp
 
 #include "stat.h"
 #include "exception.h"
@@ -37,11 +38,32 @@ const char *StatSet::varnames[NUM_STATSET_VARS] = {
 	"x", "y", "z", "r", "phi", "theta"	
 };
 	
+const char StatFileHeader::signature[4] = {'S', 'T', 'A', 'T'};
+
 void StatSet::read(std::string const & filename) {
-	//read all first so we can complain if any fields are missing
+	std::ifstream f(filename, std::ios::in | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open file " << filename;
+	char magic[sizeof(StatFileHeader::signature)] = {};
+	f.read(magic, sizeof(magic));
+	//back to the start of the same stream, for whichever reader it is
+	f.clear();
+	f.seekg(0);
+	if (!std::memcmp(magic, StatFileHeader::signature, sizeof(magic))) {
+		readBinary(f, filename);
+	} else {
+		readText(f, filename);
+	}
+}
+
+void StatSet::readText(std::string const & filename) {
 	std::ifstream f(filename);
 	if (!f.is_open()) throw Exception() << "failed to open file " << filename;	
-	
+	readText(f, filename);
+}
+
+//filename is just for errors
+void StatSet::readText(std::istream & f, std::string const & filename) {
+	//read all first so we can complain if any fields are missing
 	std::map<std::string, double> m;
 	while (!f.eof()) {
 		std::string line;
@@ -70,6 +92,37 @@ void StatSet::read(std::string const & filename) {
 			vars()[i].vars()[j] = mi->second;
 		}
 	}
+	calcSqAvg();
+}
+
+void StatSet::readBinary(std::string const & filename) {
+	std::ifstream f(filename, std::ios::in | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open file " << filename;
+	readBinary(f, filename);
+}
+
+void StatSet::readBinary(std::istream & f, std::string const & filename) {
+
+	StatFileHeader header;
+	f.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!f) throw Exception() << "failed to read header of " << filename;
+	if (std::memcmp(header.magic, StatFileHeader::signature, sizeof(header.magic))) throw Exception() << "bad signature in " << filename;
+	if (header.version > StatFileHeader::currentVersion) throw Exception() << "file " << filename << " has version " << header.version << " but I only know up to " << StatFileHeader::currentVersion;
+	if (header.numStatSetVars != NUM_STATSET_VARS || header.numStatVars != NUM_STAT_VARS) {
+		throw Exception() << "file " << filename << " has " << header.numStatSetVars << "x" << header.numStatVars << " vars, expected " << NUM_STATSET_VARS << "x" << NUM_STAT_VARS;
+	}
+
+	double values[1 + NUM_STATSET_VARS * NUM_STAT_VARS];
+	f.read(reinterpret_cast<char*>(values), sizeof(values));
+	if (!f) throw Exception() << "file " << filename << " is truncated";
+	//sketches (header.sketchSize bytes) follow.  none are defined yet, so don't bother seeking past them.
+
+	count = values[0];
+	for (int i = 0; i < NUM_STATSET_VARS; i++) {
+		for (int j = 0; j < NUM_STAT_VARS; j++) {
+			vars()[i].vars()[j] = values[1 + j + NUM_STAT_VARS * i];
+		}
+	}
 }
 
 //calcs sqavg based on stddev and avg
@@ -94,6 +147,18 @@ void StatSet::accum(const double *values) {
 	}
 }
 
+//accumulate a single xyz sample, deriving r, phi, theta from it
+void StatSet::accumPoint(double x, double y, double z) {
+	double values[NUM_STATSET_VARS];
+	values[STATSET_X] = x;
+	values[STATSET_Y] = y;
+	values[STATSET_Z] = z;
+	values[STATSET_R] = sqrt(x*x + y*y + z*z);
+	values[STATSET_PHI] = atan2(y, x);
+	values[STATSET_THETA] = acos(z / values[STATSET_R]);
+	accum(values);
+}
+
 /*
 accumulate an entire StatSet of samples
 updates min, max, avg, and sqavg
@@ -112,6 +177,29 @@ void StatSet::accum(const StatSet &set) {
 }
 
 void StatSet::write(const std::string &dstfilename) {
+	StatFileHeader header;
+	std::memcpy(header.magic, StatFileHeader::signature, sizeof(header.magic));
+	header.version = StatFileHeader::currentVersion;
+	header.numStatSetVars = NUM_STATSET_VARS;
+	header.numStatVars = NUM_STAT_VARS;
+	header.sketchSize = 0;
+
+	double values[1 + NUM_STATSET_VARS * NUM_STAT_VARS];
+	values[0] = count;
+	for (int i = 0; i < NUM_STATSET_VARS; i++) {
+		for (int j = 0; j < NUM_STAT_VARS; j++) {
+			values[1 + j + NUM_STAT_VARS * i] = vars()[i].vars()[j];
+		}
+	}
+
+	std::ofstream f(dstfilename.c_str(), std::ios::out | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open " << dstfilename << " for writing";
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(reinterpret_cast<const char*>(values), sizeof(values));
+}
+
+//the old human-readable format.  read() still accepts it.
+void StatSet::writeText(const std::string &dstfilename) {
 	std::ofstream f(dstfilename.c_str());
 	f.precision(50);
 	f << "count = " << count << std::endl;
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <istream>
 #include <ostream>
 #include <cmath>
+#include <cstdint>
 
 enum {
 	STAT_MIN,
@@ -49,6 +51,24 @@ enum {
 	NUM_STATSET_VARS
 };
 
+/*
+binary .stats layout, all little-endian as written by the host:
+	StatFileHeader
+	double count
+	double [NUM_STATSET_VARS][NUM_STAT_VARS] -- every Stat field, sqavg included, so nothing is lost to decimal round-tripping
+	char [sketchSize] -- reserved for appended sketches.  readers skip what they don't understand.
+*/
+struct StatFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numStatSetVars;
+	uint32_t numStatVars;
+	uint64_t sketchSize;
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 1;
+};
+
 struct StatSet {
 	Stat x, y, z, r, phi, theta;
 	double count;
@@ -56,10 +76,17 @@ struct StatSet {
 	StatSet() : count(0) {}
 	Stat *vars() { return &x; }
 	const Stat *vars() const { return &x; }
+	//reads either format, based on the file signature
 	void read(std::string const & filename);
+	void readText(std::string const & filename);
+	void readText(std::istream & f, std::string const & filename);
+	void readBinary(std::string const & filename);
+	void readBinary(std::istream & f, std::string const & filename);
 	void calcSqAvg();
 	void calcStdDev();
 	void accum(const double *value);
+	void accumPoint(double x, double y, double z);
 	void accum(const StatSet &set);
 	void write(const std::string &dstfilename);
+	void writeText(const std::string &dstfilename);
 };
@@ -1,6 +1,14 @@
 #include <fstream>
 #include <filesystem>
 #include <cstring>	//std::strncpy
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "util.h"
 #include "exception.h"
 
@@ -68,6 +76,66 @@ void writeFile(const std::string &filename, void *data, std::streamsize size) {
 	f.write((const char *)data, size);
 }
 
+void appendFile(const std::string &filename, void *data, std::streamsize size) {
+	std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+	f.write((const char *)data, size);
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &filename, Mode mode) : ptr(nullptr), length(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {
+	DWORD access = mode == MAP_WRITE ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+	DWORD share = mode == MAP_WRITE ? 0 : FILE_SHARE_READ;
+	file = CreateFileA(filename.c_str(), access, share, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw Exception() << "failed to open file " << filename;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw Exception() << "failed to get the size of " << filename;
+	}
+	length = (size_t)fileSize.QuadPart;
+	if (!length) return;
+	DWORD protect = mode == MAP_WRITE ? PAGE_READWRITE : mode == MAP_COPY_ON_WRITE ? PAGE_WRITECOPY : PAGE_READONLY;
+	DWORD view = mode == MAP_WRITE ? FILE_MAP_WRITE : mode == MAP_COPY_ON_WRITE ? FILE_MAP_COPY : FILE_MAP_READ;
+	mapping = CreateFileMappingA(file, nullptr, protect, 0, 0, nullptr);
+	if (mapping) ptr = MapViewOfFile(mapping, view, 0, 0, 0);
+	if (!ptr) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		throw Exception() << "failed to map file " << filename;
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (ptr) UnmapViewOfFile(ptr);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string &filename, Mode mode) : ptr(nullptr), length(0), fd(-1) {
+	fd = open(filename.c_str(), mode == MAP_WRITE ? O_RDWR : O_RDONLY);
+	if (fd == -1) throw Exception() << "failed to open file " << filename;
+	struct stat st;
+	if (fstat(fd, &st)) {
+		close(fd);
+		throw Exception() << "failed to get the size of " << filename;
+	}
+	length = (size_t)st.st_size;
+	if (!length) return;
+	int prot = mode == MAP_READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+	ptr = mmap(nullptr, length, prot, mode == MAP_COPY_ON_WRITE ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		ptr = nullptr;
+		close(fd);
+		throw Exception() << "failed to map file " << filename;
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (ptr) munmap(ptr, length);
+	if (fd != -1) close(fd);
+}
+#endif
+
 HandleArgs::HandleArgs(
 	std::vector<std::string> const & args,
 	Handlers const & handlers
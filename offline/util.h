@@ -37,6 +37,34 @@ void for_all(IteratedType &i, Function &f) {
 }
 
 void writeFile(const std::string &filename, void *data, std::streamsize size);
+void appendFile(const std::string &filename, void *data, std::streamsize size);
+
+//memory map of a whole file.  pages are loaded as they're touched, so huge files cost nothing up front.
+struct MappedFile {
+	enum Mode {
+		MAP_READ_ONLY,
+		MAP_WRITE,	//changes go to the file
+		MAP_COPY_ON_WRITE,	//changes are private to this mapping, the file is untouched
+	};
+
+	MappedFile(const std::string &filename, Mode mode = MAP_READ_ONLY);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const void *data() const { return ptr; }
+	void *data() { return ptr; }	//only writable if mapped with MAP_WRITE or MAP_COPY_ON_WRITE
+	size_t size() const { return length; }
+
+protected:
+	void *ptr;
+	size_t length;
+#ifdef _WIN32
+	void *file, *mapping;	//HANDLEs
+#else
+	int fd;
+#endif
+};
 
 #include <variant>
 
@@ -58,10 +58,10 @@ template<typename T>
 _vec<2,T> operator-(const _vec<2,T> &a, const _vec<2,T> &b) { return _vec<2,T>(a.x - b.x, a.y - b.y); }
 
 template<typename U, typename V>
-_vec<2,U> operator*(const _vec<2,U> &u, const V &v) { return _vec<2,U>(u.x + v, u.y + v); }
+_vec<2,U> operator*(const _vec<2,U> &u, const V &v) { return _vec<2,U>(u.x * v, u.y * v); }
 
 template<typename U, typename V>
-_vec<2,U> operator*(const U &u, const _vec<2,V> &v) { return _vec<2,U>(u + v.x, u + v.y); }
+_vec<2,U> operator*(const U &u, const _vec<2,V> &v) { return _vec<2,U>(u * v.x, u * v.y); }
 
 template<typename U, typename V>
 _vec<2,U> &operator*=(_vec<2,U> &u, const V &v) { u.x *= v; u.y *= v; return u; }
@@ -150,10 +150,10 @@ template<typename T>
 _vec<3,T> operator-(const _vec<3,T> &a, const _vec<3,T> &b) { return _vec<3,T>(a.x - b.x, a.y - b.y, a.z - b.z); }
 
 template<typename U, typename V>
-_vec<3,U> operator*(const _vec<3,U> &u, const V &v) { return _vec<3,U>(u.x + v, u.y + v, u.z + v); }
+_vec<3,U> operator*(const _vec<3,U> &u, const V &v) { return _vec<3,U>(u.x * v, u.y * v, u.z * v); }
 
 template<typename U, typename V>
-_vec<3,U> operator*(const U &u, const _vec<3,V> &v) { return _vec<3,U>(u + v.x, u + v.y, u + v.z); }
+_vec<3,U> operator*(const U &u, const _vec<3,V> &v) { return _vec<3,U>(u * v.x, u * v.y, u * v.z); }
 
 template<typename U, typename V>
 _vec<3,U> &operator*=(_vec<3,U> &u, const V &v) { u.x *= v; u.y *= v; u.z *= v; return u; }
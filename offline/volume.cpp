@@ -0,0 +1,136 @@
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>	//offsetof
+#include <type_traits>
+#include <cstring>	//std::memcmp
+
+#include "volume.h"
+#include "exception.h"
+
+const char SparseVolumeHeader::signature[4] = {'S', 'V', 'O', 'L'};
+
+int SparseVolumeHeader::bytesPerCell() const {
+	switch (encoding) {
+	case VOLUME_ENCODING_U8: return 1;
+	case VOLUME_ENCODING_U16: return 2;
+	default: return 4;
+	}
+}
+
+double SparseVolumeHeader::maxCellValue() const {
+	switch (encoding) {
+	case VOLUME_ENCODING_U8: return 255.;
+	case VOLUME_ENCODING_U16: return 65535.;
+	default: return 1.;
+	}
+}
+
+double SparseVolumeHeader::encode(double count) const {
+	switch (transfer) {
+	case VOLUME_TRANSFER_LOG: return log1p(count / transferScale) / log1p(maxCount / transferScale);
+	case VOLUME_TRANSFER_ASINH: return asinh(count / transferScale) / asinh(maxCount / transferScale);
+	default: return count * (1. / maxCount);
+	}
+}
+
+double SparseVolumeHeader::decode(double value) const {
+	switch (transfer) {
+	case VOLUME_TRANSFER_LOG: return expm1(value * log1p(maxCount / transferScale)) * transferScale;
+	case VOLUME_TRANSFER_ASINH: return sinh(value * asinh(maxCount / transferScale)) * transferScale;
+	default: return value * maxCount;
+	}
+}
+
+static float decodeCell(SparseVolumeHeader const & header, double cell) {
+	if (header.transfer == VOLUME_TRANSFER_LINEAR) return (float)(cell / header.maxCellValue());
+	return (float)(header.decode(cell / header.maxCellValue()) / header.maxCount);
+}
+
+template<typename Cell>
+static void decodeCells(std::ifstream &f, SparseVolumeHeader const & header, std::vector<float> &cells) {
+	std::vector<Cell> raw(cells.size());
+	f.read(reinterpret_cast<char*>(raw.data()), sizeof(Cell) * raw.size());
+	if (std::is_floating_point<Cell>::value) {
+		for (size_t i = 0; i < raw.size(); i++) {
+			cells[i] = decodeCell(header, raw[i]);
+		}
+	} else {
+		//integer encodings only have so many values, so decode each once
+		std::vector<float> table((size_t)header.maxCellValue() + 1);
+		for (size_t i = 0; i < table.size(); i++) {
+			table[i] = decodeCell(header, (double)i);
+		}
+		for (size_t i = 0; i < raw.size(); i++) {
+			cells[i] = table[(size_t)raw[i]];
+		}
+	}
+}
+
+void SparseVolume::read(std::string const & filename) {
+	std::ifstream f(filename, std::ios::in | std::ios::binary);
+	if (!f.is_open()) throw Exception() << "failed to open file " << filename;
+
+	header = {};
+	const std::streamsize version1Size = offsetof(SparseVolumeHeader, transfer);
+	f.read(reinterpret_cast<char*>(&header), version1Size);
+	if (!f) throw Exception() << "failed to read header of " << filename;
+	if (std::memcmp(header.magic, SparseVolumeHeader::signature, sizeof(header.magic))) throw Exception() << "bad signature in " << filename;
+	if (header.version > SparseVolumeHeader::currentVersion) throw Exception() << "file " << filename << " has version " << header.version << " but I only know up to " << SparseVolumeHeader::currentVersion;
+	if (header.version >= 2) {
+		f.read(reinterpret_cast<char*>(&header) + version1Size, sizeof(header) - version1Size);
+		if (!f) throw Exception() << "failed to read header of " << filename;
+	} else {
+		header.transfer = VOLUME_TRANSFER_LINEAR;
+		header.transferScale = 1;
+	}
+	if (header.encoding >= NUM_VOLUME_ENCODINGS) throw Exception() << "file " << filename << " has unknown encoding " << header.encoding;
+	if (header.transfer >= NUM_VOLUME_TRANSFERS) throw Exception() << "file " << filename << " has unknown transfer " << header.transfer;
+	if (!(header.maxCount > 0)) throw Exception() << "file " << filename << " has bad max count " << header.maxCount;
+	if (!header.brickSize || !header.size || header.size % header.brickSize) throw Exception() << "file " << filename << " has size " << header.size << " that isn't a multiple of its brick size " << header.brickSize;
+
+	long numGridBricks = (long)bricksPerSide() * bricksPerSide() * bricksPerSide();
+	if (header.numBricks > numGridBricks) throw Exception() << "file " << filename << " has " << header.numBricks << " bricks but the grid only holds " << numGridBricks;
+
+	brickIndexes.resize(header.numBricks);
+	f.read(reinterpret_cast<char*>(brickIndexes.data()), sizeof(uint32_t) * brickIndexes.size());
+	cells.resize(header.numBricks * brickVolume());
+	switch (header.encoding) {
+	case VOLUME_ENCODING_F32: decodeCells<float>(f, header, cells); break;
+	case VOLUME_ENCODING_U8: decodeCells<uint8_t>(f, header, cells); break;
+	case VOLUME_ENCODING_U16: decodeCells<uint16_t>(f, header, cells); break;
+	}
+	if (!f) throw Exception() << "file " << filename << " is truncated";
+
+	brickSlots.assign(numGridBricks, -1);
+	for (int i = 0; i < (int)brickIndexes.size(); i++) {
+		if (brickIndexes[i] >= numGridBricks) throw Exception() << "file " << filename << " has out of range brick index " << brickIndexes[i];
+		brickSlots[brickIndexes[i]] = i;
+	}
+}
+
+float SparseVolume::get(int x, int y, int z) const {
+	int n = brickSize();
+	int slot = brickSlots[x / n + bricksPerSide() * ((long)(y / n) + bricksPerSide() * (long)(z / n))];
+	if (slot < 0) return 0;
+	return cells[slot * brickVolume() + x % n + n * ((y % n) + n * (long)(z % n))];
+}
+
+std::vector<float> SparseVolume::toDense() const {
+	long s = size();
+	int n = brickSize();
+	std::vector<float> dense(s * s * s);
+	for (int i = 0; i < (int)brickIndexes.size(); i++) {
+		long bx = n * (brickIndexes[i] % bricksPerSide());
+		long by = n * ((brickIndexes[i] / bricksPerSide()) % bricksPerSide());
+		long bz = n * (brickIndexes[i] / ((long)bricksPerSide() * bricksPerSide()));
+		const float *src = cells.data() + i * brickVolume();
+		for (int z = 0; z < n; z++) {
+			for (int y = 0; y < n; y++) {
+				std::copy(src, src + n, dense.begin() + bx + s * ((by + y) + s * (bz + z)));
+				src += n;
+			}
+		}
+	}
+	return dense;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+sparse density volume.  genvolume --sparse writes these to datasets/<set>/density.svol
+the grid is cut into bricks and only bricks with something in them are stored,
+so the file size follows occupied space rather than size^3.
+a dense grid is stored as a single brick the size of the whole grid.
+
+layout, little endian:
+	SparseVolumeHeader
+	uint32_t [numBricks] -- brick indexes, x + bricksPerSide * (y + bricksPerSide * z), ascending
+	cell [numBricks][brickSize^3] -- x fastest.  float, uint8_t or uint16_t depending on encoding.
+
+cells hold transfer(count) scaled to the encoding's range, so maxCount maps to 1, 255 or 65535.
+version 1 files stop the header after maxCount and are always f32 linear.
+*/
+struct SparseVolumeHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t size;
+	uint32_t brickSize;
+	uint32_t numBricks;
+	uint32_t encoding;	//VOLUME_ENCODING_*
+	double maxCount;
+	//version 2:
+	uint32_t transfer;	//VOLUME_TRANSFER_*
+	uint32_t reserved;
+	double transferScale;	//in counts.  where log and asinh turn from linear to logarithmic.
+
+	static const char signature[4];
+	static constexpr uint32_t currentVersion = 2;
+
+	int bytesPerCell() const;
+	double encode(double count) const;	//count -> [0,1]
+	double decode(double value) const;	//[0,1] -> count
+	double maxCellValue() const;	//what 1 is stored as
+};
+
+enum {
+	VOLUME_ENCODING_F32,
+	VOLUME_ENCODING_U8,
+	VOLUME_ENCODING_U16,
+	NUM_VOLUME_ENCODINGS
+};
+
+enum {
+	VOLUME_TRANSFER_LINEAR,	//count / maxCount
+	VOLUME_TRANSFER_LOG,	//log(1 + count / scale) / log(1 + maxCount / scale)
+	VOLUME_TRANSFER_ASINH,	//asinh(count / scale) / asinh(maxCount / scale)
+	NUM_VOLUME_TRANSFERS
+};
+
+struct SparseVolume {
+	SparseVolumeHeader header;
+	std::vector<uint32_t> brickIndexes;
+	std::vector<float> cells;	//always count / maxCount, whatever the file's encoding
+	std::vector<int32_t> brickSlots;	//for every brick in the grid, where it is in brickIndexes, or -1 if it is empty
+
+	int size() const { return header.size; }
+	int brickSize() const { return header.brickSize; }
+	int bricksPerSide() const { return header.size / header.brickSize; }
+	long brickVolume() const { return (long)header.brickSize * header.brickSize * header.brickSize; }
+
+	void read(std::string const & filename);
+	float get(int x, int y, int z) const;
+	std::vector<float> toDense() const;
+};
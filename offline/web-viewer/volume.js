@@ -119,7 +119,7 @@ function ShaderProgram(args) {
 //populated in R.init
 var canvas;
 var projMat, mvMat, rotMat;
-var plainShader, volumeSliceShader;
+var plainShader, volumeSliceShader, isoShader;
 var quadVtxBuf;
 var cubeWireVtxBuf, cubeWireIndexBuf;
 var cubeVtxBuf, cubeNormalBuf;
@@ -178,6 +178,14 @@ var R = new function() {
 		gl.uniform1i(volumeSliceShader.uniforms.hsvTex, 1);
 		gl.enableVertexAttribArray(volumeSliceShader.attrs.vtx);
 
+		isoShader = new ShaderProgram({
+			vertexCodeID : 'plain-vsh',
+			fragmentCodeID : 'iso-fsh',
+			attrs : ['vtx'],
+			uniforms : ['projMat', 'mvMat', 'color']
+		});
+		gl.enableVertexAttribArray(isoShader.attrs.vtx);
+
 		gl.useProgram(null);
 
 		//create buffers
@@ -275,7 +283,7 @@ var R = new function() {
 
 var volume = new function() {
 	this.dim = 256;
-	this.init = function(f32Buffer) {
+	this.init = function() {
 		var colors = [
 			[0,0,0],
 			[0,0,1],
@@ -307,6 +315,22 @@ var volume = new function() {
 		gl.bindTexture(gl.TEXTURE_2D, null);
 
 		if (!gl.getExtension('OES_texture_float')) console.warn("Can't find support for OES_texture_float");
+	};
+
+	//(re)build the slice textures from a dim^3 buffer, Float32Array or Uint8Array.  called once per mip level as they come in.
+	this.setData = function(f32Buffer, dim) {
+		var isBytes = f32Buffer instanceof Uint8Array;
+		if (this.slices) {
+			for (var axis = 0; axis < 3; axis++) {
+				for (var w = 0; w < this.slices[axis].length; w++) {
+					gl.deleteTexture(this.slices[axis][w].tex);
+				}
+			}
+		}
+		this.dim = dim;
+		gl.useProgram(volumeSliceShader.obj);
+		gl.uniform1f(volumeSliceShader.uniforms.dz, 1/this.dim);
+		gl.useProgram(null);
 
 		//var data = new Uint8Array(this.dim * this.dim * 3);
 		this.slices = [[],[],[]];	//for each axii 
@@ -321,7 +345,7 @@ var volume = new function() {
 		}
 		
 		console.log("building slices...");
-		var data = new Float32Array(this.dim * this.dim); 
+		var data = isBytes ? new Uint8Array(this.dim * this.dim) : new Float32Array(this.dim * this.dim); 
 
 		var x = vec3.create();
 		for (var axis = 0; axis < 3; axis++) {
@@ -338,7 +362,7 @@ var volume = new function() {
 					}
 				}
 				gl.bindTexture(gl.TEXTURE_2D, slice.tex);
-				gl.texImage2D(gl.TEXTURE_2D, 0, gl.LUMINANCE, this.dim, this.dim, 0, gl.LUMINANCE, gl.FLOAT, data);
+				gl.texImage2D(gl.TEXTURE_2D, 0, gl.LUMINANCE, this.dim, this.dim, 0, gl.LUMINANCE, isBytes ? gl.UNSIGNED_BYTE : gl.FLOAT, data);
 				gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.LINEAR);
 				gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST);
 				gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
@@ -352,10 +376,50 @@ var volume = new function() {
 	};
 };
 
+//meshes from offline/genisos, one per iso level
+var isos = new function() {
+	this.levels = [];
+	//see offline/genisos.cpp for the layout
+	this.init = function(arrayBuffer) {
+		var data = new DataView(arrayBuffer);
+		var magic = String.fromCharCode(data.getUint8(0), data.getUint8(1), data.getUint8(2), data.getUint8(3));
+		if (magic != 'MESH') error("bad mesh signature");
+		var numLevels = data.getUint32(8, true);
+		var ofs = 12 + 12 * numLevels;
+		var uintIndexes = gl.getExtension('OES_element_index_uint');
+		for (var i = 0; i < numLevels; i++) {
+			var level = {
+				iso : data.getFloat32(12 + 12 * i, true),
+				numVertexes : data.getUint32(16 + 12 * i, true),
+				numTriangles : data.getUint32(20 + 12 * i, true)
+			};
+			var vtxs = new Float32Array(arrayBuffer.slice(ofs, ofs + 12 * level.numVertexes));
+			ofs += 12 * level.numVertexes;
+			var indexes = new Uint32Array(arrayBuffer.slice(ofs, ofs + 12 * level.numTriangles));
+			ofs += 12 * level.numTriangles;
+			if (!uintIndexes && level.numVertexes > 65536) {
+				console.warn("skipping iso "+level.iso+", too many vertexes without OES_element_index_uint");
+				continue;
+			}
+
+			level.vtxBuf = gl.createBuffer();
+			gl.bindBuffer(gl.ARRAY_BUFFER, level.vtxBuf);
+			gl.bufferData(gl.ARRAY_BUFFER, vtxs, gl.STATIC_DRAW);
+			level.indexBuf = gl.createBuffer();
+			gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, level.indexBuf);
+			gl.bufferData(gl.ELEMENT_ARRAY_BUFFER, uintIndexes ? indexes : new Uint16Array(indexes), gl.STATIC_DRAW);
+			level.indexType = uintIndexes ? gl.UNSIGNED_INT : gl.UNSIGNED_SHORT;
+			this.levels.push(level);
+		}
+		R.redraw();
+	};
+};
+
 var gamma = 10.;
 var drawWireframe = true;
 var drawSlices = true;
 var drawVolume = false;
+var drawIsos = true;
 $(document).ready(function() {
 	$('#gamma-slider').slider({
 		range : 'max',
@@ -376,15 +440,153 @@ $(document).ready(function() {
 		drawSlices = e.target.checked; 
 		R.redraw();
 	});
+	$('#draw-isos').click(function(e) {
+		drawIsos = e.target.checked;
+		R.redraw();
+	});
 	$('#draw-volume').click(function(e) {
 		drawVolume = e.target.checked;
 		R.redraw();
 	});
+
+	R.init();
+	adjustSize();
+	volume.init();
+
+	loadArrayBuffer('../datasets/2mrs/isos.mesh', function(arrayBuffer) {
+		isos.init(arrayBuffer);
+	}, function() {});
+
+	//try the brick pyramid first, coarsest level first, then the sparse volume, then the dense volume
+	$.getJSON(bricksDir + 'index.json')
+		.done(function(index) {
+			var region = getRegion();
+			var last = pickBrickLevel(index, region);
+			loadBrickLevel(index, region, index.levels.length-1, last);
+		})
+		.fail(function() {
+			loadArrayBuffer('../datasets/2mrs/density.svol', function(arrayBuffer) {
+				var sparse = readSparseVolume(arrayBuffer);
+				volume.setData(sparse.data, sparse.size);
+			}, function() {
+				loadFloats('../datasets/2mrs/density.vol', function(f32Buffer) {
+					volume.setData(f32Buffer, Math.round(Math.cbrt(f32Buffer.length)));
+				});
+			});
+		});
+})
+
+var bricksDir = '../datasets/2mrs/density-bricks/';
+
+/*
+range is an optional [begin, end) of bytes.
+servers that ignore Range send the whole file, in which case done's second argument is true.
+*/
+function loadArrayBuffer(url, done, fail, range) {
 	var xhr = new XMLHttpRequest();
-	xhr.open('GET', '../datasets/2mrs/density.vol', true);
+	xhr.open('GET', url, true);
 	xhr.responseType = 'arraybuffer';
-	xhr.addEventListener('load', e => {
-		var arrayBuffer = this.response;
+	if (range) xhr.setRequestHeader('Range', 'bytes='+range[0]+'-'+(range[1]-1));
+	xhr.addEventListener('load', function() {
+		if (xhr.status == 206 && range) {
+			done(xhr.response, false);
+		} else if (xhr.status == 200) {
+			done(xhr.response, !!range);
+		} else {
+			if (fail) fail();
+		}
+	});
+	if (fail) xhr.addEventListener('error', fail);
+	xhr.send();
+}
+
+//done gets an ArrayBuffer per [begin, end) range.  if the server sends the whole file for the first, the rest are cut from it.
+function loadRanges(url, ranges, done) {
+	var buffers = [];
+	var remaining = ranges.length;
+	if (!remaining) {
+		done(buffers);
+		return;
+	}
+	var fail = function() { error("failed to load "+url); };
+	loadArrayBuffer(url, function(arrayBuffer, whole) {
+		if (whole) {
+			$.each(ranges, function(r, range) {
+				buffers[r] = arrayBuffer.slice(range[0], range[1]);
+			});
+			done(buffers);
+			return;
+		}
+		buffers[0] = arrayBuffer;
+		if (!--remaining) done(buffers);
+		$.each(ranges.slice(1), function(r, range) {
+			loadArrayBuffer(url, function(arrayBuffer) {
+				buffers[r+1] = arrayBuffer;
+				if (!--remaining) done(buffers);
+			}, fail, range);
+		});
+	}, fail, ranges[0]);
+}
+
+/*
+see offline/volume.h for the layout.
+cells are shown as stored, i.e. after the log/asinh transfer, since that is the point of it.
+u8 stays bytes all the way to the texture upload, f32 and u16 come back as floats in [0,1].
+*/
+function readSparseVolume(arrayBuffer) {
+	var data = new DataView(arrayBuffer);
+	var magic = String.fromCharCode(data.getUint8(0), data.getUint8(1), data.getUint8(2), data.getUint8(3));
+	if (magic != 'SVOL') error("bad sparse volume signature");
+	var version = data.getUint32(4, true);
+	var size = data.getUint32(8, true);
+	var brickSize = data.getUint32(12, true);
+	var numBricks = data.getUint32(16, true);
+	var encoding = data.getUint32(20, true);
+	var headerSize = version >= 2 ? 48 : 32;
+
+	var getCell, bytesPerCell, buffer;
+	switch (encoding) {
+	case 0:	//f32
+		bytesPerCell = 4;
+		getCell = function(ofs) { return data.getFloat32(ofs, true); };
+		buffer = new Float32Array(size * size * size);
+		break;
+	case 1:	//u8
+		bytesPerCell = 1;
+		getCell = function(ofs) { return data.getUint8(ofs); };
+		buffer = new Uint8Array(size * size * size);
+		break;
+	case 2:	//u16
+		bytesPerCell = 2;
+		getCell = function(ofs) { return data.getUint16(ofs, true) / 65535; };
+		buffer = new Float32Array(size * size * size);
+		break;
+	default:
+		error("unknown sparse volume encoding "+encoding);
+	}
+
+	var bricksPerSide = size / brickSize;
+	var src = headerSize + 4 * numBricks;
+	for (var b = 0; b < numBricks; b++) {
+		var brickIndex = data.getUint32(headerSize + 4 * b, true);
+		var bx = brickSize * (brickIndex % bricksPerSide);
+		var by = brickSize * (Math.floor(brickIndex / bricksPerSide) % bricksPerSide);
+		var bz = brickSize * Math.floor(brickIndex / (bricksPerSide * bricksPerSide));
+		for (var k = 0; k < brickSize; k++) {
+			for (var j = 0; j < brickSize; j++) {
+				var dst = bx + size * ((by + j) + size * (bz + k));
+				for (var i = 0; i < brickSize; i++) {
+					buffer[dst + i] = getCell(src);
+					src += bytesPerCell;
+				}
+			}
+		}
+	}
+	return {size : size, data : buffer};
+}
+
+function loadFloats(url, done) {
+	loadArrayBuffer(url, function(arrayBuffer) {
 		var data = new DataView(arrayBuffer);
 		
 		var f32Buffer = new Float32Array(data.byteLength / Float32Array.BYTES_PER_ELEMENT);
@@ -392,16 +594,119 @@ $(document).ready(function() {
 		for (var jj = 0; jj < len; ++jj) {
 			f32Buffer[jj] = data.getFloat32(jj * Float32Array.BYTES_PER_ELEMENT, true);
 		}
-	
-		R.init();
+		done(f32Buffer);
+	});
+}
+
+/*
+?region=x,y,z,width picks a cube of the volume to show, in fractions of its size.  default is all of it.
+?maxDim=n is the most cells across to show, default 256.  the pyramid is only loaded down to the finest level that fits.
+*/
+function getUrlParam(name) {
+	var m = new RegExp('[?&]'+name+'=([^&]*)').exec(location.search);
+	return m ? decodeURIComponent(m[1]) : undefined;
+}
+
+function getRegion() {
+	var region = {min : [0,0,0], width : 1};
+	var s = getUrlParam('region');
+	if (s !== undefined) {
+		var v = $.map(s.split(','), parseFloat);
+		if (v.length != 4 || !(v[3] > 0) || v.some(isNaN)) error("expected region=x,y,z,width");
+		region.width = Math.min(v[3], 1);
+		for (var i = 0; i < 3; i++) {
+			region.min[i] = Math.max(0, Math.min(v[i], 1 - region.width));
+		}
+	}
+	return region;
+}
+
+//finest level whose part of the region is at most maxDim across
+function pickBrickLevel(index, region) {
+	var maxDim = parseInt(getUrlParam('maxDim')) || 256;
+	for (var l = 0; l < index.levels.length; l++) {
+		if (region.width * index.levels[l].size <= maxDim) return l;
+	}
+	return index.levels.length-1;
+}
 
-		adjustSize();
+/*
+fetch the bricks of this level that overlap the region, unpack them into a dense dim^3 buffer, show it,
+then go on to the next finer level, stopping after lastLevelIndex.
+bricks are byte ranges of level.file, see writeBricks in offline/genvolume.cpp.  adjacent ones are fetched together.
+*/
+function loadBrickLevel(index, region, levelIndex, lastLevelIndex) {
+	if (levelIndex < lastLevelIndex) return;
+	var level = index.levels[levelIndex];
+	var n = index.brickSize;
+	var size = level.size;
+	var bricksPerSide = size / n;
+	var dim = Math.max(1, Math.min(size, Math.round(region.width * size)));
+	var min = [], brickMin = [], brickMax = [];
+	for (var i = 0; i < 3; i++) {
+		min[i] = Math.min(Math.floor(region.min[i] * size), size - dim);
+		brickMin[i] = Math.floor(min[i] / n);
+		brickMax[i] = Math.floor((min[i] + dim - 1) / n);
+	}
 
-		volume.init(f32Buffer);
+	var wanted = [];
+	var ranges = [];
+	$.each(level.bricks, function(b, brick) {
+		var brickIndex = brick[0];
+		var bpos = [brickIndex % bricksPerSide, Math.floor(brickIndex / bricksPerSide) % bricksPerSide, Math.floor(brickIndex / (bricksPerSide * bricksPerSide))];
+		for (var i = 0; i < 3; i++) {
+			if (bpos[i] < brickMin[i] || bpos[i] > brickMax[i]) return;
+		}
+		var last = ranges[ranges.length-1];
+		if (last && last[1] == brick[1]) {
+			last[1] += brick[2];
+		} else {
+			ranges.push([brick[1], brick[1] + brick[2]]);
+		}
+		wanted.push({pos : bpos, range : ranges.length-1, offset : brick[1] - ranges[ranges.length-1][0]});
 	});
-	xhr.send();
 
-})
+	loadRanges(bricksDir + level.file, ranges, function(buffers) {
+		var buffer, getCell, bytesPerCell;
+		switch (index.encoding) {
+		case 'u8':
+			bytesPerCell = 1;
+			getCell = function(data, ofs) { return data.getUint8(ofs); };
+			buffer = new Uint8Array(dim * dim * dim);
+			break;
+		case 'u16':
+			bytesPerCell = 2;
+			getCell = function(data, ofs) { return data.getUint16(ofs, true) / 65535; };
+			buffer = new Float32Array(dim * dim * dim);
+			break;
+		default:	//f32
+			bytesPerCell = 4;
+			getCell = function(data, ofs) { return data.getFloat32(ofs, true); };
+			buffer = new Float32Array(dim * dim * dim);
+		}
+		$.each(wanted, function(w, brick) {
+			var data = new DataView(buffers[brick.range]);
+			var b0 = [], c0 = [], c1 = [];
+			for (var i = 0; i < 3; i++) {
+				b0[i] = n * brick.pos[i];
+				c0[i] = Math.max(b0[i], min[i]);
+				c1[i] = Math.min(b0[i] + n, min[i] + dim);
+			}
+			for (var z = c0[2]; z < c1[2]; z++) {
+				for (var y = c0[1]; y < c1[1]; y++) {
+					var src = brick.offset + bytesPerCell * ((c0[0] - b0[0]) + n * ((y - b0[1]) + n * (z - b0[2])));
+					var dst = (c0[0] - min[0]) + dim * ((y - min[1]) + dim * (z - min[2]));
+					for (var x = c0[0]; x < c1[0]; x++) {
+						buffer[dst++] = getCell(data, src);
+						src += bytesPerCell;
+					}
+				}
+			}
+		});
+		volume.setData(buffer, dim);
+		loadBrickLevel(index, region, levelIndex-1, lastLevelIndex);
+	});
+}
 
 function adjustSize() {
 	$(canvas)
@@ -438,7 +743,21 @@ function draw() {
 		gl.drawElements(gl.LINES, 24, gl.UNSIGNED_SHORT, 0);
 	}
 
-	if (drawSlices) {
+	if (drawIsos && isos.levels.length) {
+		gl.useProgram(isoShader.obj);
+		gl.uniformMatrix4fv(isoShader.uniforms.projMat, false, projMat);
+		gl.uniformMatrix4fv(isoShader.uniforms.mvMat, false, viewMat);
+		$.each(isos.levels, function(i, level) {
+			var f = (i + 1) / isos.levels.length;
+			gl.uniform4f(isoShader.uniforms.color, f, .5, 1 - f, .3);
+			gl.bindBuffer(gl.ARRAY_BUFFER, level.vtxBuf);
+			gl.vertexAttribPointer(isoShader.attrs.vtx, 3, gl.FLOAT, false, 0, 0);
+			gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, level.indexBuf);
+			gl.drawElements(gl.TRIANGLES, 3 * level.numTriangles, level.indexType, 0);
+		});
+	}
+
+	if (drawSlices && volume.slices) {
 		gl.useProgram(volumeSliceShader.obj);
 		gl.bindBuffer(gl.ARRAY_BUFFER, quadVtxBuf);
 		gl.vertexAttribPointer(volumeSliceShader.attrs.vtx, 3, gl.FLOAT, false, 0, 0);	//3=stride